@@ -43,13 +43,7 @@ PROCESS_THREAD(app_process, ev, data) {
       printf("App: Controller started\n");
 #endif
     } else if (node_role == NODE_ROLE_SENSOR_ACTUATOR) {
-      size_t i;
-      for (i = 0; i < NUM_SENSORS; ++i) {
-        if (linkaddr_cmp(&SENSORS[i], &linkaddr_node_addr)) {
-          sensor_init(i);
-          break;
-        }
-      }
+      sensor_init(node_get_sensor_index());
 #ifdef STATS
       printf("App: Sensor/actuator started\n");
 #endif
@@ -24,28 +24,134 @@
 #define ETC_EVENT_FORWARD_DELAY (random_rand() % (CLOCK_SECOND / 10))
 
 /**
- * @brief Time to wait before sending a collect message.
+ * @brief Number of overheard copies of an event message after which the node
+ * cancels its own pending rebroadcast.
  */
-#define ETC_COLLECT_START_DELAY \
-  (CLOCK_SECOND * 3 + random_rand() % (CLOCK_SECOND * 2))
+#define ETC_EVENT_SUPPRESSION_COUNTER (3)
+
+/**
+ * @brief Minimum number of neighbors to cancel an event message rebroadcast.
+ * In sparse areas the rebroadcast is always sent to preserve coverage, in
+ * dense areas the counter threshold decreases down to 2 copies.
+ */
+#define ETC_EVENT_SUPPRESSION_MIN_NEIGHBORS (3)
+
+/**
+ * @brief Piggyback sensor readings on the event flood.
+ * Every Sensor node adds its reading to the event message it rebroadcasts,
+ * together with the readings of the copies overheard before.
+ * A Sensor node skips its collect message if the rebroadcast of the
+ * Controller node shows that its reading has already been received.
+ */
+#define ETC_EVENT_PIGGYBACK (true)
+
+/**
+ * @brief Maximum number of readings piggybacked on an event message.
+ * Each reading takes 9 byte.
+ */
+#define ETC_EVENT_PIGGYBACK_MAX_SIZE (4)
+
+/**
+ * @brief Time the Controller node waits before rebroadcasting an event message
+ * when piggybacking.
+ * Gathers the readings of the first copies before acknowledging them, must be
+ * shorter than ETC_COLLECT_FLOOD_TIME.
+ */
+#define ETC_EVENT_PIGGYBACK_ECHO_DELAY (CLOCK_SECOND / 4)
+
+/**
+ * @brief Time to wait after the event detection for the event flood to
+ * settle before the collect wave starts.
+ */
+#define ETC_COLLECT_FLOOD_TIME (CLOCK_SECOND / 2)
+
+/**
+ * @brief Collect slot duration of a depth level.
+ * Shorter than ETC_COLLECT_AGGREGATION_WINDOW so that a relay aggregates its
+ * own reading with the ones of the deeper level.
+ */
+#define ETC_COLLECT_SLOT (CLOCK_SECOND / 5)
+
+/**
+ * @brief Maximum depth of the collect wave.
+ * Deeper nodes share the first slot.
+ */
+#define ETC_COLLECT_MAX_DEPTH (6)
+
+/**
+ * @brief Excess of the value over the threshold from which an event is
+ * critical.
+ * A critical event preempts the own in flight event or, if the rounds are
+ * full, an in flight event that is not critical.
+ */
+#define ETC_EVENT_CRITICAL_MARGIN (CONTROLLER_MAX_DIFF / 2)
+
+/**
+ * @brief Maximum number of event rounds in flight.
+ * Events of different sources are handled in parallel, further events are
+ * suppressed.
+ */
+#define ETC_MAX_ROUNDS (2)
 
 /**
  * @brief New event generation suppression time.
+ * Lifetime of the round of an own event.
+ * Safety ceiling, suppression ends earlier when the round is complete.
  */
 #define ETC_SUPPRESSION_EVENT_NEW (CLOCK_SECOND * 12)
 
 /**
  * @brief Event propagation suppression time.
+ * Lifetime of the round of a received event, safety ceiling as above.
  */
 #define ETC_SUPPRESSION_EVENT_PROPAGATION \
   (ETC_SUPPRESSION_EVENT_NEW - CLOCK_SECOND / 2)
 
 /**
- * @brief Time to wait to disable suppression propagation after received a
- * command message.
+ * @brief Time to wait to disable suppression after the round is complete.
+ * The round is complete when the round end message of the event is received,
+ * the wait lets the last command messages be delivered.
  */
 #define ETC_SUPPRESSION_EVENT_PROPAGATION_END (CLOCK_SECOND / 2)
 
+/**
+ * @brief Time after the event detection within which a collect message must
+ * be delivered.
+ * After it the Controller has stopped waiting for readings.
+ */
+#define ETC_COLLECT_DEADLINE (CONTROLLER_COLLECT_WAIT)
+
+/**
+ * @brief Time within which a buffered command message must be delivered.
+ */
+#define ETC_COMMAND_DEADLINE (CLOCK_SECOND * 5)
+
+/**
+ * @brief Maximum number of commands bundled in the round end message.
+ * Commands of a round beyond it are sent in unicast.
+ */
+#define ETC_COMMAND_BUNDLE_MAX_SIZE (8)
+
+/**
+ * @brief Maximum value difference from the last reading acknowledged by the
+ * Controller node for a reading to be unchanged.
+ * An unchanged reading is sent as a bit in the collect message.
+ */
+#define ETC_COLLECT_DELTA (SENSOR_UPDATE_INCREMENT_MAX)
+
+/**
+ * @brief Time to wait for further collect readings before forwarding them
+ * aggregated in a single collect message.
+ */
+#define ETC_COLLECT_AGGREGATION_WINDOW (CLOCK_SECOND / 4)
+
+/**
+ * @brief Maximum number of readings in a collect message.
+ * Each reading takes 11 byte, keep the message (and its recorded route) within
+ * a single frame.
+ */
+#define ETC_COLLECT_AGGREGATION_MAX_SIZE (6)
+
 /* --- CONTROLLER --- */
 /**
  * @brief Controller address.
@@ -63,18 +169,128 @@ extern const linkaddr_t CONTROLLER;
 #define CONTROLLER_MAX_THRESHOLD (50000)
 
 /**
- * @brief Time to wait before analyzing the Sensor readings.
+ * @brief Maximum time to wait before analyzing the Sensor readings.
+ * The collect window closes earlier once the missing readings are overdue
+ * (see CONTROLLER_COLLECT_DELAY_DEVIATIONS).
  */
 #define CONTROLLER_COLLECT_WAIT (CLOCK_SECOND * 10)
 
+/**
+ * @brief Weight (percentage) of the history in the collect delay EWMAs.
+ */
+#define CONTROLLER_COLLECT_DELAY_ALPHA (80)
+
+/**
+ * @brief Number of mean deviations above the mean collect delay of a Sensor
+ * node after which its reading is overdue.
+ */
+#define CONTROLLER_COLLECT_DELAY_DEVIATIONS (4)
+
+/**
+ * @brief Minimum margin above the mean collect delay of a Sensor node after
+ * which its reading is overdue.
+ */
+#define CONTROLLER_COLLECT_DELAY_MARGIN (CLOCK_SECOND / 2)
+
+/**
+ * @brief Percentage of the collect window after which the missing readings
+ * are pulled from the Sensor nodes (once per round).
+ */
+#define CONTROLLER_PULL_AT (50)
+
+/**
+ * @brief Number of consecutive rounds with a missed collect after which a
+ * Sensor node is suspected dead.
+ * A round does not wait for a suspected dead Sensor node, it is alive again
+ * once a collect is received.
+ */
+#define CONTROLLER_LIVENESS_MAX_MISSED (3)
+
+/**
+ * @brief Maximum error of a cached Sensor reading.
+ * The value of a Sensor node grows by less than SENSOR_UPDATE_INCREMENT_MAX
+ * per SENSOR_UPDATE_INTERVAL, a cached reading with a larger error bound is
+ * collected again.
+ */
+#define CONTROLLER_READING_MAX_ERROR (CONTROLLER_MAX_DIFF / 10)
+
 /* --- SENSOR --- */
 /**
- * @brief Total number of Sensor nodes available.
+ * @brief Memory budget in byte for the per sensor tables of a node.
+ * Determines the maximum number of Sensor nodes that can register.
+ * 50 Sensor nodes need 50 * SENSORS_MEMORY_PER_SENSOR = 5300 byte: it fits
+ * the 32 KB of RAM of a Firefly, the 10 KB of a TMote Sky are limited to
+ * about 20.
+ */
+#ifndef CONTIKI_TARGET_SKY
+#define SENSORS_MEMORY_BUDGET (5300)
+#else
+#define SENSORS_MEMORY_BUDGET (2048)
+#endif
+
+/**
+ * @brief Memory in byte used by a registered Sensor node in the registry
+ * (address and 2 index entries).
+ * Each per sensor table is checked at compile time against its share.
+ */
+#define SENSORS_MEMORY_REGISTRY (4)
+
+/**
+ * @brief Memory in byte used by a registered Sensor node in the forwardings
+ * (hops and recorded route).
+ */
+#define SENSORS_MEMORY_FORWARD (26)
+
+/**
+ * @brief Memory in byte used by a registered Sensor node in the advertised
+ * subtrees (one distance per child).
+ */
+#define SENSORS_MEMORY_ADVERTISEMENT (8)
+
+/**
+ * @brief Memory in byte used by a registered Sensor node in ETC (last event
+ * and round end sequence numbers).
+ */
+#define SENSORS_MEMORY_ETC (4)
+
+/**
+ * @brief Memory in byte used by a registered Sensor node in the Controller
+ * (a reading per round in flight, event sequence number, cache, delay
+ * estimate and liveness).
+ */
+#define SENSORS_MEMORY_CONTROLLER (ETC_MAX_ROUNDS * 16 + 32)
+
+/**
+ * @brief Memory in byte used by a registered Sensor node in the tables of a
+ * node.
+ */
+#define SENSORS_MEMORY_PER_SENSOR                      \
+  (SENSORS_MEMORY_REGISTRY + SENSORS_MEMORY_FORWARD +  \
+   SENSORS_MEMORY_ADVERTISEMENT + SENSORS_MEMORY_ETC + \
+   SENSORS_MEMORY_CONTROLLER)
+
+/**
+ * @brief Maximum number of Sensor nodes that can register.
+ * Sensor nodes are assigned a slot in [0, MAX_SENSORS) at runtime.
+ */
+#define MAX_SENSORS (SENSORS_MEMORY_BUDGET / SENSORS_MEMORY_PER_SENSOR)
+#if MAX_SENSORS >= 255
+#error "Sensor node slots must fit in a byte"
+#endif
+
+/**
+ * @brief Number of nodes in the Sensor/Actuator role list.
  */
 #define NUM_SENSORS (5)
+#if MAX_SENSORS < NUM_SENSORS
+#error "Sensor nodes memory budget too small for the Sensor/Actuator role list"
+#endif
 
 /**
- * @brief Sensors addresses.
+ * @brief Addresses of the nodes with the Sensor/Actuator role.
+ * Only used by a node to know its own role: Sensor nodes are learned by the
+ * network at runtime (see registry), a new Sensor node does not require to
+ * update the other nodes.
  */
 extern const linkaddr_t SENSORS[NUM_SENSORS];
 
@@ -83,10 +299,15 @@ extern const linkaddr_t SENSORS[NUM_SENSORS];
  */
 #define SENSOR_UPDATE_INTERVAL (CLOCK_SECOND * 7)
 
+/**
+ * @brief Maximum increment (exclusive) of the sensed value per interval.
+ */
+#define SENSOR_UPDATE_INCREMENT_MAX (300)
+
 /**
  * @brief Random increment to add to the old sensed value.
  */
-#define SENSOR_UPDATE_INCREMENT (random_rand() % 300)
+#define SENSOR_UPDATE_INCREMENT (random_rand() % SENSOR_UPDATE_INCREMENT_MAX)
 
 /**
  * @brief Initial sensed value step.
@@ -112,27 +333,88 @@ extern const linkaddr_t SENSORS[NUM_SENSORS];
  */
 #define CONNECTION_MAX_HOPS (16)
 
+/**
+ * @brief Maximum number of addresses in a unicast header route.
+ * Collect messages record the last ones, command messages use them as source
+ * route: the remaining path is covered by the forwarding rules.
+ */
+#define CONNECTION_ROUTE_MAX_SIZE (6)
+
 /**
  * @brief Maximum number of connections to store.
  */
 #define CONNECTION_BEACON_MAX_CONNECTIONS (3)
 
 /**
- * @brief Interval to (re)create the connections tree.
+ * @brief Maximum number of neighbors to store.
+ * Connections are chosen among the stored neighbors.
+ */
+#define CONNECTION_NEIGHBOR_MAX_SIZE (8)
+
+/**
+ * @brief ETX fixed point scale.
+ * An ETX of 1 transmission is represented as CONNECTION_ETX_SCALE.
+ */
+#define CONNECTION_ETX_SCALE (10)
+
+/**
+ * @brief Initial link ETX of a new neighbor.
+ */
+#define CONNECTION_ETX_INITIAL (CONNECTION_ETX_SCALE * 3 / 2)
+
+/**
+ * @brief ETX penalty added to the number of transmissions of a unicast message
+ * that has not been acknowledged.
+ */
+#define CONNECTION_ETX_FAILURE_PENALTY (CONNECTION_ETX_SCALE * 5)
+
+/**
+ * @brief Link ETX above which a neighbor is not a valid connection.
+ */
+#define CONNECTION_ETX_MAX (CONNECTION_ETX_SCALE * 10)
+
+/**
+ * @brief Path ETX a new parent must improve on the current one to replace it.
+ */
+#define CONNECTION_ETX_HYSTERESIS (CONNECTION_ETX_SCALE)
+
+/**
+ * @brief Weight (percentage) of the history in the link estimator EWMAs.
+ */
+#define CONNECTION_EWMA_ALPHA (80)
+
+/**
+ * @brief Minimum beacon (Trickle) interval.
+ * Interval used after an inconsistency has been detected.
  */
-#define CONNECTION_BEACON_INTERVAL (CLOCK_SECOND * 30)
+#define CONNECTION_BEACON_TRICKLE_IMIN (CLOCK_SECOND)
 
 /**
- * @brief Time to wait before sending a beacon message.
+ * @brief Maximum number of times the minimum beacon (Trickle) interval could
+ * be doubled while the connections tree is consistent.
  */
-#define CONNECTION_BEACON_FORWARD_DELAY (random_rand() % CLOCK_SECOND)
+#define CONNECTION_BEACON_TRICKLE_IMAX_DOUBLINGS (8)
+
+/**
+ * @brief Maximum beacon (Trickle) interval.
+ */
+#define CONNECTION_BEACON_TRICKLE_IMAX \
+  (CONNECTION_BEACON_TRICKLE_IMIN << CONNECTION_BEACON_TRICKLE_IMAX_DOUBLINGS)
+
+/**
+ * @brief Redundancy constant.
+ * A beacon message is suppressed if at least k consistent beacon messages
+ * have been received in the current interval.
+ */
+#define CONNECTION_BEACON_TRICKLE_K (2)
 
 /**
  * @brief Unicast buffer size.
  * The maximum number of unicast messages that the buffer could store.
- * A good value is the number of Sensor nodes available.
+ * Collect messages are aggregated, so it does not grow with the number of
+ * Sensor nodes.
  */
-#define CONNECTION_UC_BUFFER_SIZE (NUM_SENSORS)
+#define CONNECTION_UC_BUFFER_SIZE (5)
 
 /**
  * @brief Maximum number of send attempts for a packet in the buffer.
@@ -155,4 +437,67 @@ extern const linkaddr_t SENSORS[NUM_SENSORS];
  */
 #define CONNECTION_FORWARD_DISCOVERY_TIMEOUT (CLOCK_SECOND * 1)
 
+/**
+ * @brief Size in byte of a Sensor node bitmap (one bit per Sensor node slot),
+ * as the advertised subtree.
+ */
+#define CONNECTION_SUBTREE_SIZE ((MAX_SENSORS + 7) / 8)
+
+/**
+ * @brief Time to wait before advertising the subtree after a change.
+ * Changes close in time are advertised in a single message.
+ */
+#define CONNECTION_ADVERTISEMENT_DELAY \
+  (CLOCK_SECOND / 2 + random_rand() % (CLOCK_SECOND / 2))
+
+/**
+ * @brief Interval to advertise the subtree even if unchanged.
+ */
+#define CONNECTION_ADVERTISEMENT_REFRESH_INTERVAL (CLOCK_SECOND * 60)
+
+/**
+ * @brief Time after which a child that stopped advertising its subtree is
+ * removed.
+ */
+#define CONNECTION_ADVERTISEMENT_LIFETIME \
+  (CONNECTION_ADVERTISEMENT_REFRESH_INTERVAL * 3)
+
+/**
+ * @brief Time within which a buffered advertisement message must be delivered.
+ */
+#define CONNECTION_ADVERTISEMENT_DEADLINE (CLOCK_SECOND * 5)
+
+/**
+ * @brief Size of the registry address index (hash table).
+ * Keep it larger than MAX_SENSORS to have short probe sequences.
+ */
+#define CONNECTION_REGISTRY_INDEX_SIZE (MAX_SENSORS * 2)
+
+/**
+ * @brief Maximum number of Sensor node addresses in a registry message.
+ */
+#define CONNECTION_REGISTRY_CHUNK_SIZE (8)
+
+/**
+ * @brief Interval between join messages of a Sensor node not yet registered.
+ */
+#define CONNECTION_REGISTRY_JOIN_INTERVAL \
+  (CLOCK_SECOND * 5 + random_rand() % (CLOCK_SECOND * 5))
+
+/**
+ * @brief Time within which a buffered join message must be delivered.
+ */
+#define CONNECTION_REGISTRY_JOIN_DEADLINE (CLOCK_SECOND * 5)
+
+/**
+ * @brief Interval to flood (a chunk of) the registry even if unchanged.
+ * Repairs the registry of nodes that missed a registration.
+ */
+#define CONNECTION_REGISTRY_REFRESH_INTERVAL (CLOCK_SECOND * 60)
+
+/**
+ * @brief Time to wait before forwarding a registry message.
+ */
+#define CONNECTION_REGISTRY_FORWARD_DELAY (random_rand() % (CLOCK_SECOND / 4))
+
 #endif
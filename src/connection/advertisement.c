@@ -0,0 +1,386 @@
+#include "advertisement.h"
+
+#include <net/packetbuf.h>
+#include <string.h>
+#include <sys/cc.h>
+
+#include "config/config.h"
+#include "connection/forward.h"
+#include "connection/registry.h"
+#include "logger/logger.h"
+#include "node/node.h"
+
+/**
+ * @brief Child entry.
+ * Subtree advertised by a child node.
+ * Note that an entry with linkaddr_null address is free.
+ */
+struct child_t {
+  /* Child address. */
+  linkaddr_t address;
+  /* Hop distance of each Sensor node slot from the child (UINT8_MAX if not in
+   * subtree). */
+  uint8_t distances[MAX_SENSORS];
+  /* Time of the last advertisement. */
+  clock_time_t time;
+};
+
+/**
+ * @brief Children structure.
+ */
+static struct child_t children[CONNECTION_NEIGHBOR_MAX_SIZE];
+
+/* Per sensor distances within their share of the memory budget */
+_Static_assert(CONNECTION_NEIGHBOR_MAX_SIZE * sizeof(children[0].distances) <=
+                   MAX_SENSORS * SENSORS_MEMORY_ADVERTISEMENT,
+               "SENSORS_MEMORY_ADVERTISEMENT too small");
+
+/**
+ * @brief Last advertised message.
+ */
+static struct advertisement_msg_t last_msg;
+
+/**
+ * @brief Last advertised message size in byte.
+ */
+static size_t last_msg_size;
+
+/**
+ * @brief Parent node of the last advertisement.
+ */
+static linkaddr_t last_parent;
+
+/**
+ * @brief Flag if the advertisement has been triggered by a change.
+ */
+static bool triggered;
+
+/**
+ * @brief Advertisement timer.
+ */
+static struct ctimer advertisement_timer;
+
+/**
+ * @brief Advertisement timer callback.
+ * Expires old children and sends the advertisement if needed.
+ *
+ * @param ignored
+ */
+static void advertisement_timer_cb(void *ignored);
+
+/**
+ * @brief Send an advertisement message in unicast.
+ *
+ * @param msg Advertisement message.
+ * @param msg_size Message size in byte.
+ * @param receiver Receiver node address.
+ * @return true Advertisement message sent.
+ * @return false Advertisement message not sent due to an error.
+ */
+static bool send_advertisement_message(const struct advertisement_msg_t *msg,
+                                       size_t msg_size,
+                                       const linkaddr_t *receiver);
+
+/**
+ * @brief Build the advertisement message of the subtree.
+ *
+ * @param msg Advertisement message.
+ * @return Message size in byte.
+ */
+static size_t build_message(struct advertisement_msg_t *msg);
+
+/**
+ * @brief Remove children that stopped advertising.
+ */
+static void expire_children(void);
+
+/**
+ * @brief Find a child entry by address.
+ *
+ * @param address Child address.
+ * @return Child entry or NULL if not found.
+ */
+static struct child_t *find(const linkaddr_t *address);
+
+/**
+ * @brief Remove a child and its forwarding rules.
+ *
+ * @param child Child entry.
+ */
+static void remove_child(struct child_t *child);
+
+/**
+ * @brief Reset children structure.
+ */
+static void reset(void);
+
+/* --- --- */
+void advertisement_init(void) {
+  reset();
+
+  /* Controller has no parent */
+  if (node_get_role() == NODE_ROLE_CONTROLLER) return;
+
+  ctimer_set(&advertisement_timer, CONNECTION_ADVERTISEMENT_REFRESH_INTERVAL,
+             advertisement_timer_cb, NULL);
+}
+
+void advertisement_terminate(void) {
+  reset();
+  ctimer_stop(&advertisement_timer);
+}
+
+void advertisement_trigger(void) {
+  /* Controller has no parent */
+  if (node_get_role() == NODE_ROLE_CONTROLLER) return;
+
+  /* Already scheduled */
+  if (triggered) return;
+
+  triggered = true;
+  ctimer_set(&advertisement_timer, CONNECTION_ADVERTISEMENT_DELAY,
+             advertisement_timer_cb, NULL);
+}
+
+void advertisement_withdraw(const linkaddr_t *old_parent) {
+  struct advertisement_msg_t msg;
+
+  /* Nothing advertised to the old parent */
+  if (!linkaddr_cmp(old_parent, &last_parent) ||
+      last_msg_size <= ADVERTISEMENT_MSG_SIZE(0))
+    return;
+
+  /* Empty subtree */
+  memset(msg.subtree, 0, sizeof(msg.subtree));
+  if (!send_advertisement_message(&msg, ADVERTISEMENT_MSG_SIZE(0), old_parent))
+    return;
+
+  LOG_INFO("Withdrawing subtree from old parent %02x:%02x", old_parent->u8[0],
+           old_parent->u8[1]);
+
+  /* Nothing advertised anymore */
+  last_msg_size = 0;
+  linkaddr_copy(&last_parent, &linkaddr_null);
+}
+
+void advertisement_recv_cb(const struct unicast_hdr_t *header,
+                           const linkaddr_t *sender) {
+  struct advertisement_msg_t msg;
+  struct child_t *child;
+  size_t num_distances = 0;
+  size_t i;
+
+  /* Check received advertisement message validity */
+  if (packetbuf_datalen() < ADVERTISEMENT_MSG_SIZE(0) ||
+      packetbuf_datalen() > sizeof(msg)) {
+    LOG_ERROR("Received advertisement message wrong size: %u byte",
+              packetbuf_datalen());
+    return;
+  }
+
+  /* Copy advertisement message */
+  packetbuf_copyto(&msg);
+
+  /* Check distances */
+  for (i = 0; i < MAX_SENSORS; ++i) {
+    if (msg.subtree[i / 8] & (1 << (i % 8))) num_distances += 1;
+  }
+  if (packetbuf_datalen() != ADVERTISEMENT_MSG_SIZE(num_distances)) {
+    LOG_ERROR("Received advertisement message wrong distances: %u in %u byte",
+              num_distances, packetbuf_datalen());
+    return;
+  }
+
+  LOG_INFO("Received advertisement message from %02x:%02x: { sensors: %u }",
+           sender->u8[0], sender->u8[1], num_distances);
+
+  /* Find child (or free entry, or oldest) */
+  child = find(sender);
+  if (child == NULL) child = find(&linkaddr_null);
+  if (child == NULL) {
+    child = &children[0];
+    for (i = 1; i < CONNECTION_NEIGHBOR_MAX_SIZE; ++i) {
+      if ((clock_time_t)(child->time - children[i].time) <
+          ((clock_time_t)~0 >> 1))
+        child = &children[i];
+    }
+    remove_child(child);
+  }
+
+  /* Save */
+  linkaddr_copy(&child->address, sender);
+  child->time = clock_time();
+  num_distances = 0;
+  for (i = 0; i < MAX_SENSORS; ++i) {
+    if (!(msg.subtree[i / 8] & (1 << (i % 8)))) {
+      /* Not in subtree (anymore) */
+      if (child->distances[i] != UINT8_MAX) forward_remove_hop(i, sender);
+      child->distances[i] = UINT8_MAX;
+      continue;
+    }
+
+    child->distances[i] = msg.distances[num_distances++];
+
+    /* Learn */
+    forward_add(i, sender, MIN(child->distances[i] + 1, UINT8_MAX));
+  }
+
+  /* Empty subtree */
+  if (num_distances == 0) remove_child(child);
+
+  /* Subtree could have changed */
+  advertisement_trigger();
+}
+
+static void advertisement_timer_cb(void *ignored) {
+  struct advertisement_msg_t msg;
+  const linkaddr_t *parent = &connection_get_conn()->parent_node;
+  const bool refresh = !triggered;
+  size_t msg_size;
+
+  triggered = false;
+
+  /* Schedule refresh */
+  ctimer_set(&advertisement_timer, CONNECTION_ADVERTISEMENT_REFRESH_INTERVAL,
+             advertisement_timer_cb, NULL);
+
+  expire_children();
+
+  /* Check connection */
+  if (!connection_is_connected()) return;
+
+  /* Build */
+  msg_size = build_message(&msg);
+
+  /* Ignore if nothing changed */
+  if (!refresh && linkaddr_cmp(parent, &last_parent) &&
+      msg_size == last_msg_size && memcmp(&msg, &last_msg, msg_size) == 0)
+    return;
+
+  /* Nothing to advertise to a new parent */
+  if (msg_size == ADVERTISEMENT_MSG_SIZE(0) &&
+      last_msg_size <= ADVERTISEMENT_MSG_SIZE(0))
+    return;
+
+  /* Send advertisement message in unicast to parent node */
+  if (!send_advertisement_message(&msg, msg_size, parent)) return;
+
+  LOG_INFO("Sending advertisement message to %02x:%02x: { size: %u }",
+           parent->u8[0], parent->u8[1], msg_size);
+
+  /* Save */
+  memcpy(&last_msg, &msg, msg_size);
+  last_msg_size = msg_size;
+  linkaddr_copy(&last_parent, parent);
+}
+
+static bool send_advertisement_message(const struct advertisement_msg_t *msg,
+                                       size_t msg_size,
+                                       const linkaddr_t *receiver) {
+  struct unicast_hdr_t header;
+
+  /* Prepare header */
+  header.type = UNICAST_MSG_TYPE_ADVERTISEMENT;
+  header.hops = 0;
+  header.route_length = 0;
+
+  /* Prepare packetbuf */
+  packetbuf_clear();
+  packetbuf_copyfrom(msg, msg_size);
+
+  /* Send advertisement message in unicast to receiver node */
+  if (!connection_unicast_send(
+          &header, receiver,
+          clock_time() + CONNECTION_ADVERTISEMENT_DEADLINE)) {
+    LOG_ERROR("Error sending advertisement message to %02x:%02x",
+              receiver->u8[0], receiver->u8[1]);
+    return false;
+  }
+
+  return true;
+}
+
+static size_t build_message(struct advertisement_msg_t *msg) {
+  const uint8_t own_slot = registry_find(&linkaddr_node_addr);
+  uint8_t distance;
+  size_t num_distances = 0;
+  size_t i;
+  size_t j;
+
+  memset(msg->subtree, 0, sizeof(msg->subtree));
+
+  for (i = 0; i < MAX_SENSORS; ++i) {
+    /* Me */
+    distance = i == own_slot ? 0 : UINT8_MAX;
+
+    /* Nearest child */
+    for (j = 0; j < CONNECTION_NEIGHBOR_MAX_SIZE; ++j) {
+      if (linkaddr_cmp(&children[j].address, &linkaddr_null) ||
+          children[j].distances[i] == UINT8_MAX)
+        continue;
+      /* Ignore parent (could be a stale child) */
+      if (linkaddr_cmp(&children[j].address,
+                       &connection_get_conn()->parent_node))
+        continue;
+      distance = MIN(distance, children[j].distances[i] + 1);
+    }
+
+    if (distance == UINT8_MAX) continue;
+
+    msg->subtree[i / 8] |= 1 << (i % 8);
+    msg->distances[num_distances++] = distance;
+  }
+
+  return ADVERTISEMENT_MSG_SIZE(num_distances);
+}
+
+static void expire_children(void) {
+  size_t i;
+
+  for (i = 0; i < CONNECTION_NEIGHBOR_MAX_SIZE; ++i) {
+    if (linkaddr_cmp(&children[i].address, &linkaddr_null)) continue;
+    if ((clock_time_t)(clock_time() - children[i].time) <
+        CONNECTION_ADVERTISEMENT_LIFETIME)
+      continue;
+
+    LOG_WARN("Child %02x:%02x stopped advertising", children[i].address.u8[0],
+             children[i].address.u8[1]);
+    remove_child(&children[i]);
+  }
+}
+
+static struct child_t *find(const linkaddr_t *address) {
+  size_t i;
+
+  for (i = 0; i < CONNECTION_NEIGHBOR_MAX_SIZE; ++i) {
+    if (linkaddr_cmp(address, &children[i].address)) return &children[i];
+  }
+
+  return NULL;
+}
+
+static void remove_child(struct child_t *child) {
+  size_t i;
+
+  for (i = 0; i < MAX_SENSORS; ++i) {
+    if (child->distances[i] != UINT8_MAX)
+      forward_remove_hop(i, &child->address);
+    child->distances[i] = UINT8_MAX;
+  }
+  linkaddr_copy(&child->address, &linkaddr_null);
+}
+
+/* --- RESET --- */
+static void reset(void) {
+  size_t i;
+  size_t j;
+
+  for (i = 0; i < CONNECTION_NEIGHBOR_MAX_SIZE; ++i) {
+    linkaddr_copy(&children[i].address, &linkaddr_null);
+    for (j = 0; j < MAX_SENSORS; ++j) children[i].distances[j] = UINT8_MAX;
+    children[i].time = 0;
+  }
+  last_msg_size = 0;
+  linkaddr_copy(&last_parent, &linkaddr_null);
+  triggered = false;
+}
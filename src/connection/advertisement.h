@@ -0,0 +1,47 @@
+#ifndef _CONNECTION_ADVERTISEMENT_H_
+#define _CONNECTION_ADVERTISEMENT_H_
+
+#include <net/linkaddr.h>
+
+#include "connection/connection.h"
+
+/**
+ * @brief Initialize advertisement operation(s).
+ */
+void advertisement_init(void);
+
+/**
+ * @brief Terminate advertisement operation(s).
+ */
+void advertisement_terminate(void);
+
+/**
+ * @brief Schedule a subtree advertisement to the parent node.
+ * To be called when the parent node or the subtree could have changed.
+ * Nothing is sent if the subtree and the parent node are unchanged.
+ */
+void advertisement_trigger(void);
+
+/**
+ * @brief Withdraw the subtree from the old parent node.
+ * An empty advertisement is sent so that the old parent node removes its
+ * forwarding rules through this node at once, instead of after
+ * CONNECTION_ADVERTISEMENT_LIFETIME.
+ * Nothing is sent if nothing has been advertised to the old parent node.
+ *
+ * @param old_parent Address of the old parent node.
+ */
+void advertisement_withdraw(const linkaddr_t *old_parent);
+
+/**
+ * @brief Advertisement receive callback.
+ * A forwarding rule through the sender is added for every Sensor node in its
+ * subtree.
+ *
+ * @param header Unicast header.
+ * @param sender Address of the sender node (child).
+ */
+void advertisement_recv_cb(const struct unicast_hdr_t *header,
+                           const linkaddr_t *sender);
+
+#endif
@@ -1,22 +1,47 @@
 #include "beacon.h"
 
 #include <net/packetbuf.h>
+#include <sys/cc.h>
 
 #include "config/config.h"
+#include "connection/advertisement.h"
+#include "connection/neighbor.h"
 #include "logger/logger.h"
 #include "node/node.h"
 
+/* The maximum interval must fit in clock_time_t (16 bit on sky) */
+_Static_assert((clock_time_t)CONNECTION_BEACON_TRICKLE_IMAX ==
+                   CONNECTION_BEACON_TRICKLE_IMAX,
+               "CONNECTION_BEACON_TRICKLE_IMAX overflows clock_time_t");
+
 /**
  * @brief Connection(s) object.
  * Ordered from best (0) to worst (length-1).
  */
 static struct connection_t connections[CONNECTION_BEACON_MAX_CONNECTIONS];
 
+/**
+ * @brief Trickle state.
+ */
+static struct {
+  /* Current interval. */
+  clock_time_t interval;
+  /* Number of consistent beacon messages received in the current interval. */
+  uint8_t counter;
+} trickle;
+
 /**
  * @brief Beacon message generation timer.
+ * Expires at a random time in the second half of the current interval.
  */
 static struct ctimer beacon_timer;
 
+/**
+ * @brief Trickle interval timer.
+ * Expires at the end of the current interval.
+ */
+static struct ctimer trickle_timer;
+
 /**
  * @brief Beacon timer callback.
  *
@@ -24,6 +49,27 @@ static struct ctimer beacon_timer;
  */
 static void beacon_timer_cb(void *ignored);
 
+/**
+ * @brief Trickle timer callback.
+ * Double the interval (up to the maximum) and start a new one.
+ *
+ * @param ignored.
+ */
+static void trickle_timer_cb(void *ignored);
+
+/**
+ * @brief Start a new Trickle interval.
+ * Reset the counter and schedule the beacon message in [I/2, I).
+ */
+static void trickle_start_interval(void);
+
+/**
+ * @brief Reset Trickle interval to the minimum.
+ * Called when an inconsistency is detected.
+ * Nothing is done if the interval is already the minimum.
+ */
+static void trickle_reset(void);
+
 /**
  * @brief Send beacon message.
  *
@@ -44,28 +90,34 @@ static void reset_connections(void);
 static void reset_connections_idx(size_t index);
 
 /**
- * @brief Shift connections to right starting from index.
- * From parameter must be within the range of the array (0, length - 1).
- * The from entry is resetted.
- * Example:
- * [1 2 3 FROM 5 6 7] -> [1 2 3 ? 4 5 6]
- * The ? entry is resetted.
+ * @brief Check if a neighbor could be a connection.
+ * Neighbors do not expire: a stale parent is only dropped when its connection
+ * is invalidated (see beacon_invalidate_connection).
  *
- * @param from Start index to shift from.
+ * @param neighbor Neighbor entry.
+ * @return true Valid connection.
+ * @return false Invalid connection.
  */
-static void shift_right_connections(size_t from);
+static bool is_candidate(const struct neighbor_t *neighbor);
 
 /**
- * @brief Shift connections to left starting from index.
- * From parameter must be within the range of the array (0, length - 1).
- * The last entry is resetted.
- * Example:
- * [1 2 3 FROM 5 6 7] -> [1 2 3 5 6 7 ?]
- * The ? entry is resetted.
+ * @brief Save neighbor as connection at index in connections.
  *
- * @param from Start index to shift from.
+ * @param index Connection index.
+ * @param neighbor Neighbor entry.
  */
-static void shift_left_connections(size_t from);
+static void set_connection(size_t index, const struct neighbor_t *neighbor);
+
+/**
+ * @brief Rebuild connections from the neighbor table.
+ * Valid neighbors are ordered by path ETX.
+ * The current parent is kept unless a neighbor improves its path ETX by at
+ * least CONNECTION_ETX_HYSTERESIS.
+ *
+ * @return true Best connection changed.
+ * @return false Best connection unchanged.
+ */
+static bool update_connections(void);
 
 /**
  * @brief Print connection(s) array.
@@ -77,17 +129,23 @@ void beacon_init(void) {
   /* Initialize connection structure */
   reset_connections();
 
+  /* Initialize Trickle */
+  trickle.interval = 0;
+  trickle.counter = 0;
+
   /* Tree construction */
   if (node_get_role() == NODE_ROLE_CONTROLLER) {
     connections[0].hopn = 0;
-    /* Schedule the first beacon message flood */
-    ctimer_set(&beacon_timer, CLOCK_SECOND, beacon_timer_cb, NULL);
+    connections[0].etx = 0;
+    /* Start the first beacon message flood */
+    trickle_reset();
   }
 }
 
 void beacon_terminate(void) {
   reset_connections();
   ctimer_stop(&beacon_timer);
+  ctimer_stop(&trickle_timer);
 }
 
 const struct connection_t *beacon_get_conn(void) {
@@ -107,19 +165,14 @@ static void send_beacon_message(const struct beacon_msg_t *beacon_msg) {
     LOG_ERROR("Error sending beacon message");
     return;
   }
-  LOG_DEBUG("Sending beacon message: { seqn: %u, hopn: %u }", beacon_msg->seqn,
-            beacon_msg->hopn);
+  LOG_DEBUG("Sending beacon message: { hopn: %u, etx: %u }", beacon_msg->hopn,
+            beacon_msg->etx);
 }
 
 void beacon_recv_cb(const struct broadcast_hdr_t *header,
                     const linkaddr_t *sender) {
   struct beacon_msg_t beacon_msg;
-  uint16_t rssi;
-  size_t connection_index = 0;
-  size_t i;
-
-  /* Skip if controller node */
-  if (node_get_role() == NODE_ROLE_CONTROLLER) return;
+  int16_t rssi;
 
   /* Check received beacon message validity */
   if (packetbuf_datalen() != sizeof(beacon_msg)) {
@@ -131,110 +184,109 @@ void beacon_recv_cb(const struct broadcast_hdr_t *header,
   /* Copy beacon message */
   packetbuf_copyto(&beacon_msg);
 
+  /* Disconnected neighbor asking for a beacon message */
+  if (beacon_msg.hopn == UINT16_MAX) {
+    LOG_DEBUG("Received beacon request from %02x:%02x", sender->u8[0],
+              sender->u8[1]);
+    /* Inconsistency: answer soon if able to */
+    if (node_get_role() == NODE_ROLE_CONTROLLER || connection_is_connected())
+      trickle_reset();
+    return;
+  }
+
+  /* Skip if controller node */
+  if (node_get_role() == NODE_ROLE_CONTROLLER) return;
+
   /* Read RSSI of last reception */
-  rssi = packetbuf_attr(PACKETBUF_ATTR_RSSI);
+  rssi = (int16_t)packetbuf_attr(PACKETBUF_ATTR_RSSI);
 
   LOG_DEBUG(
       "Received beacon message from %02x:%02x with rssi %d: "
-      "{ seqn: %u, hopn: %u}",
-      sender->u8[0], sender->u8[1], rssi, beacon_msg.seqn, beacon_msg.hopn);
-
-  /* Analyze received beacon message */
-  if (rssi <= CONNECTION_RSSI_THRESHOLD) return; /* Too Weak */
-  if (beacon_msg.seqn != 0 && beacon_msg.seqn < connections[0].seqn)
-    return; /* Old (Keep in mind seqn overflow) */
-  if (beacon_msg.seqn == connections[0].seqn) {
-    /* Same sequence number, check... */
-    for (connection_index = 0;
-         connection_index < CONNECTION_BEACON_MAX_CONNECTIONS;
-         ++connection_index) {
-      if ((beacon_msg.seqn == 0 &&
-           beacon_msg.seqn < connections[connection_index].seqn) ||
-          beacon_msg.seqn > connections[connection_index].seqn) {
-        break; /* Better -> New */
-      }
-
-      if (beacon_msg.hopn + 1 > connections[connection_index].hopn) {
-        continue; /* Worse -> Far */
-      }
-      if (beacon_msg.hopn + 1 == connections[connection_index].hopn &&
-          rssi <= connections[connection_index].rssi) {
-        continue; /* Worse -> Weak */
-      }
-
-      /* Better -> Near or Strong */
-      break;
-    }
-
-    if (connection_index >= CONNECTION_BEACON_MAX_CONNECTIONS)
-      return; /* Far or Weak */
+      "{ hopn: %u, etx: %u }",
+      sender->u8[0], sender->u8[1], rssi, beacon_msg.hopn, beacon_msg.etx);
+
+  /* Update link estimation */
+  neighbor_update_beacon(sender, beacon_msg.hopn, beacon_msg.etx, rssi);
+
+  /* Rebuild connections */
+  if (update_connections()) {
+    /* Inconsistency: propagate new best connection */
+    trickle_reset();
+  } else {
+    /* Consistent */
+    if (trickle.counter < UINT8_MAX) trickle.counter += 1;
   }
+}
 
-  /* Remove (possible) duplicate parent node */
-  i = 0;
-  while (i < CONNECTION_BEACON_MAX_CONNECTIONS) {
-    if (linkaddr_cmp(&connections[i].parent_node, sender)) {
-      shift_left_connections(i);
-      LOG_DEBUG("Removed duplicate parent node %02x:%02x", sender->u8[0],
-                sender->u8[1]);
-      /* Adjust connection index */
-      if (i < connection_index) connection_index -= 1;
-    } else {
-      ++i;
-    }
+void beacon_update_connections(void) {
+  /* Skip if controller node */
+  if (node_get_role() == NODE_ROLE_CONTROLLER) return;
+
+  /* Inconsistency: best connection changed */
+  if (update_connections()) trickle_reset();
+}
+
+static void beacon_timer_cb(void *ignored) {
+  /* Suppress if enough consistent beacon messages have been received */
+  if (trickle.counter >= CONNECTION_BEACON_TRICKLE_K) {
+    LOG_DEBUG("Beacon message suppressed: %u consistent received",
+              trickle.counter);
+    return;
   }
 
-  /* Right shift connections to accomodate better ith connection */
-  shift_right_connections(connection_index);
+  /* Prepare beacon message.
+   * If disconnected hopn is UINT16_MAX and neighbors are asked for a beacon
+   * message. */
+  const struct beacon_msg_t beacon_msg = {.hopn = connections[0].hopn,
+                                          .etx = connections[0].etx};
 
-  /* Save better ith parent node */
-  linkaddr_copy(&connections[connection_index].parent_node, sender);
-  connections[connection_index].seqn = beacon_msg.seqn;
-  connections[connection_index].hopn = beacon_msg.hopn + 1;
-  connections[connection_index].rssi = rssi;
+  /* Send beacon message */
+  send_beacon_message(&beacon_msg);
+}
 
-  print_connections();
+/* --- TRICKLE --- */
+static void trickle_timer_cb(void *ignored) {
+  /* Double interval (compare first: doubling could overflow) */
+  trickle.interval = trickle.interval >= CONNECTION_BEACON_TRICKLE_IMAX / 2
+                         ? CONNECTION_BEACON_TRICKLE_IMAX
+                         : trickle.interval * 2;
 
-  if (connection_index == 0) {
-    /* New best (connection) parent */
-    LOG_INFO("New parent %02x:%02x: { hopn: %u, rssi: %d }",
-             connections[0].parent_node.u8[0], connections[0].parent_node.u8[1],
-             connections[0].hopn, connections[0].rssi);
-    /* Schedule beacon message propagation only if best */
-    ctimer_set(&beacon_timer, CONNECTION_BEACON_FORWARD_DELAY, beacon_timer_cb,
-               NULL);
-  } else
-    LOG_DEBUG("Backup parent %02x:%02x at %d: { hopn: %u, rssi: %d }",
-              connections[connection_index].parent_node.u8[0],
-              connections[connection_index].parent_node.u8[1], connection_index,
-              connections[connection_index].hopn,
-              connections[connection_index].rssi);
+  /* Next interval */
+  trickle_start_interval();
 }
 
-static void beacon_timer_cb(void *ignored) {
-  /* Prepare beacon message */
-  const struct beacon_msg_t beacon_msg = {.seqn = connections[0].seqn,
-                                          .hopn = connections[0].hopn};
+static void trickle_start_interval(void) {
+  trickle.counter = 0;
 
-  /* Send beacon message */
-  send_beacon_message(&beacon_msg);
+  /* Beacon message at t in [I/2, I) */
+  ctimer_set(&beacon_timer,
+             trickle.interval / 2 + random_rand() % (trickle.interval / 2),
+             beacon_timer_cb, NULL);
+  /* End of interval */
+  ctimer_set(&trickle_timer, trickle.interval, trickle_timer_cb, NULL);
+}
 
-  if (node_get_role() == NODE_ROLE_CONTROLLER) {
-    /* Rebuild tree from scratch */
+static void trickle_reset(void) {
+  /* Ignore if already minimum */
+  if (trickle.interval == CONNECTION_BEACON_TRICKLE_IMIN &&
+      !ctimer_expired(&trickle_timer))
+    return;
 
-    /* Increase beacon sequence number */
-    connections[0].seqn += 1;
-    /* Schedule next beacon message flood */
-    ctimer_set(&beacon_timer, CONNECTION_BEACON_INTERVAL, beacon_timer_cb,
-               NULL);
-  }
+  LOG_DEBUG("Resetting beacon interval");
+
+  trickle.interval = CONNECTION_BEACON_TRICKLE_IMIN;
+  trickle_start_interval();
 }
 
 /* --- CONNECTIONS --- */
 void beacon_invalidate_connection(void) {
-  /* Shift connections to left removing current best connection */
-  shift_left_connections(0);
-  print_connections();
+  /* Remove current best connection from neighbors */
+  neighbor_remove(&connections[0].parent_node);
+  /* Next best connection */
+  update_connections();
+
+  /* Inconsistency: connection changed */
+  trickle_reset();
 }
 
 static void reset_connections(void) {
@@ -248,37 +300,98 @@ static void reset_connections_idx(size_t index) {
   if (index < 0 || index >= CONNECTION_BEACON_MAX_CONNECTIONS) return;
 
   linkaddr_copy(&connections[index].parent_node, &linkaddr_null);
-  connections[index].seqn = 0;
   connections[index].hopn = UINT16_MAX;
+  connections[index].etx = UINT16_MAX;
   connections[index].rssi = CONNECTION_RSSI_THRESHOLD;
 }
 
-static void shift_right_connections(size_t from) {
-  if (from < 0 || from >= CONNECTION_BEACON_MAX_CONNECTIONS) return;
+static bool is_candidate(const struct neighbor_t *neighbor) {
+  return neighbor->path_etx != UINT16_MAX &&
+         neighbor->hopn + 1 < CONNECTION_MAX_HOPS &&
+         neighbor->rssi > CONNECTION_RSSI_THRESHOLD &&
+         neighbor->etx < CONNECTION_ETX_MAX;
+}
+
+static void set_connection(size_t index, const struct neighbor_t *neighbor) {
+  if (index >= CONNECTION_BEACON_MAX_CONNECTIONS) return;
 
+  linkaddr_copy(&connections[index].parent_node, &neighbor->address);
+  connections[index].hopn = neighbor->hopn + 1;
+  connections[index].etx = neighbor_path_etx(neighbor);
+  connections[index].rssi = neighbor->rssi;
+}
+
+static bool update_connections(void) {
+  const struct neighbor_t *best[CONNECTION_BEACON_MAX_CONNECTIONS];
+  const struct neighbor_t *parent = neighbor_find(&connections[0].parent_node);
+  const struct neighbor_t *neighbor;
+  const uint16_t old_hopn = connections[0].hopn;
+  linkaddr_t old_parent;
+  size_t num_best = 0;
   size_t i;
-  for (i = CONNECTION_BEACON_MAX_CONNECTIONS - 1; i > from; --i) {
-    linkaddr_copy(&connections[i].parent_node, &connections[i - 1].parent_node);
-    connections[i].seqn = connections[i - 1].seqn;
-    connections[i].hopn = connections[i - 1].hopn;
-    connections[i].rssi = connections[i - 1].rssi;
+  size_t j;
+
+  linkaddr_copy(&old_parent, &connections[0].parent_node);
+
+  /* Insertion sort of the best candidates by path ETX */
+  for (i = 0; i < CONNECTION_NEIGHBOR_MAX_SIZE; ++i) {
+    neighbor = neighbor_get(i);
+    if (neighbor == NULL || !is_candidate(neighbor)) continue;
+
+    for (j = num_best; j > 0 && neighbor_path_etx(neighbor) <
+                                    neighbor_path_etx(best[j - 1]);
+         --j) {
+      if (j < CONNECTION_BEACON_MAX_CONNECTIONS) best[j] = best[j - 1];
+    }
+    if (j >= CONNECTION_BEACON_MAX_CONNECTIONS) continue; /* Worse */
+
+    best[j] = neighbor;
+    if (num_best < CONNECTION_BEACON_MAX_CONNECTIONS) num_best += 1;
   }
 
-  reset_connections_idx(from);
-}
+  /* Hysteresis: keep current parent if best is not enough better */
+  if (parent != NULL && is_candidate(parent) && num_best > 0 &&
+      best[0] != parent &&
+      neighbor_path_etx(parent) <
+          (uint32_t)neighbor_path_etx(best[0]) + CONNECTION_ETX_HYSTERESIS) {
+    /* Find parent (or drop worst) */
+    for (j = 0; j < num_best && best[j] != parent; ++j)
+      ;
+    if (j >= num_best) {
+      if (num_best < CONNECTION_BEACON_MAX_CONNECTIONS)
+        num_best += 1;
+      else
+        j = num_best - 1;
+    }
+    /* Move parent to front */
+    for (; j > 0; --j) best[j] = best[j - 1];
+    best[0] = parent;
+  }
 
-static void shift_left_connections(size_t from) {
-  if (from < 0 || from >= CONNECTION_BEACON_MAX_CONNECTIONS) return;
+  /* Save */
+  reset_connections();
+  for (i = 0; i < num_best; ++i) set_connection(i, best[i]);
 
-  size_t i;
-  for (i = from; i < CONNECTION_BEACON_MAX_CONNECTIONS - 1; ++i) {
-    linkaddr_copy(&connections[i].parent_node, &connections[i + 1].parent_node);
-    connections[i].seqn = connections[i + 1].seqn;
-    connections[i].hopn = connections[i + 1].hopn;
-    connections[i].rssi = connections[i + 1].rssi;
+  print_connections();
+
+  /* Check change */
+  if (linkaddr_cmp(&old_parent, &connections[0].parent_node) &&
+      old_hopn == connections[0].hopn)
+    return false;
+
+  if (connection_is_connected())
+    LOG_INFO("New parent %02x:%02x: { hopn: %u, etx: %u, rssi: %d }",
+             connections[0].parent_node.u8[0], connections[0].parent_node.u8[1],
+             connections[0].hopn, connections[0].etx, connections[0].rssi);
+
+  /* Withdraw subtree from old parent (if still a neighbor) and advertise it
+   * to new parent */
+  if (!linkaddr_cmp(&old_parent, &connections[0].parent_node)) {
+    if (neighbor_find(&old_parent) != NULL) advertisement_withdraw(&old_parent);
+    advertisement_trigger();
   }
 
-  reset_connections_idx(i);
+  return true;
 }
 
 static void print_connections(void) {
@@ -292,9 +405,9 @@ static void print_connections(void) {
   printf("[ ");
   for (i = 0; i < CONNECTION_BEACON_MAX_CONNECTIONS; ++i) {
     conn = &connections[i];
-    printf("%u{ parent_node: %02x:%02x, seqn: %u, hopn: %u, rssi: %d } ", i,
-           conn->parent_node.u8[0], conn->parent_node.u8[1], conn->seqn,
-           conn->hopn, conn->rssi);
+    printf("%u{ parent_node: %02x:%02x, hopn: %u, etx: %u, rssi: %d } ", i,
+           conn->parent_node.u8[0], conn->parent_node.u8[1], conn->hopn,
+           conn->etx, conn->rssi);
   }
   printf("]\n");
   logger_set_newline(true);
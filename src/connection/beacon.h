@@ -31,6 +31,11 @@ const struct connection_t *beacon_get_conn(void);
 void beacon_recv_cb(const struct broadcast_hdr_t *header,
                     const linkaddr_t *sender);
 
+/**
+ * @brief Rebuild connections after a link estimation update.
+ */
+void beacon_update_connections(void);
+
 /**
  * @brief Invalidate current connection.
  * New connection (if any) is the next available backup connection.
@@ -0,0 +1,258 @@
+#include "codec.h"
+
+#include <string.h>
+
+/**
+ * @brief Size in byte of the fixed part of an encoded collect message.
+ */
+#define COLLECT_FIXED_SIZE (1 + 2 + 1 + CONNECTION_SUBTREE_SIZE + 1)
+
+/**
+ * @brief Size in byte of the fixed part of an encoded command message.
+ */
+#define COMMAND_FIXED_SIZE (1 + 2 + 1 + 1 + 1)
+
+/**
+ * @brief Size in byte of the fixed part of an encoded round end message.
+ */
+#define ROUND_END_FIXED_SIZE (1 + 2 + 1 + CONNECTION_SUBTREE_SIZE + 1)
+
+/**
+ * @brief Encode a value as a varint (7 bit per byte, least significant
+ * first, high bit set if more bytes follow).
+ *
+ * @param buffer Destination buffer.
+ * @param size Buffer size in byte.
+ * @param value Value.
+ * @return Encoded size in byte, 0 if the buffer is too small.
+ */
+static size_t varint_pack(uint8_t *buffer, size_t size, uint32_t value);
+
+/**
+ * @brief Decode a varint.
+ *
+ * @param value Value.
+ * @param buffer Source buffer.
+ * @param length Available size in byte.
+ * @return Decoded size in byte, 0 if malformed or truncated.
+ */
+static size_t varint_unpack(uint32_t *value, const uint8_t *buffer,
+                            size_t length);
+
+/* --- COLLECT --- */
+size_t codec_collect_pack(uint8_t *buffer, size_t size,
+                          const struct collect_msg_t *collect_msg) {
+  const struct collect_reading_t *reading;
+  size_t length = COLLECT_FIXED_SIZE;
+  size_t n;
+  size_t i;
+
+  if (size < COLLECT_FIXED_SIZE) return 0;
+
+  buffer[0] = CODEC_VERSION;
+  buffer[1] = collect_msg->event_seqn & 0xFF;
+  buffer[2] = collect_msg->event_seqn >> 8;
+  buffer[3] = collect_msg->event_source;
+  memcpy(&buffer[4], collect_msg->unchanged, CONNECTION_SUBTREE_SIZE);
+  buffer[4 + CONNECTION_SUBTREE_SIZE] = collect_msg->num_readings;
+
+  for (i = 0; i < collect_msg->num_readings; ++i) {
+    reading = &collect_msg->readings[i];
+
+    if (size - length < 2) return 0;
+    buffer[length++] = reading->sender;
+    buffer[length++] = reading->hops;
+
+    n = varint_pack(&buffer[length], size - length, reading->value);
+    if (n == 0) return 0;
+    length += n;
+
+    n = varint_pack(&buffer[length], size - length, reading->threshold);
+    if (n == 0) return 0;
+    length += n;
+  }
+
+  return length;
+}
+
+bool codec_collect_unpack(struct collect_msg_t *collect_msg,
+                          const uint8_t *buffer, size_t length) {
+  struct collect_reading_t *reading;
+  size_t offset = COLLECT_FIXED_SIZE;
+  /* Packed members could be unaligned */
+  uint32_t value;
+  size_t n;
+  size_t i;
+
+  if (length < COLLECT_FIXED_SIZE || buffer[0] != CODEC_VERSION) return false;
+
+  collect_msg->event_seqn = buffer[1] | (uint16_t)buffer[2] << 8;
+  collect_msg->event_source = buffer[3];
+  memcpy(collect_msg->unchanged, &buffer[4], CONNECTION_SUBTREE_SIZE);
+  collect_msg->num_readings = buffer[4 + CONNECTION_SUBTREE_SIZE];
+
+  if (collect_msg->num_readings > ETC_COLLECT_AGGREGATION_MAX_SIZE)
+    return false;
+
+  for (i = 0; i < collect_msg->num_readings; ++i) {
+    reading = &collect_msg->readings[i];
+
+    if (length - offset < 2) return false;
+    reading->sender = buffer[offset++];
+    reading->hops = buffer[offset++];
+
+    n = varint_unpack(&value, &buffer[offset], length - offset);
+    if (n == 0) return false;
+    reading->value = value;
+    offset += n;
+
+    n = varint_unpack(&value, &buffer[offset], length - offset);
+    if (n == 0) return false;
+    reading->threshold = value;
+    offset += n;
+  }
+
+  /* Trailing bytes */
+  return offset == length;
+}
+
+/* --- COMMAND --- */
+size_t codec_command_pack(uint8_t *buffer, size_t size,
+                          const struct command_msg_t *command_msg) {
+  size_t n;
+
+  if (size < COMMAND_FIXED_SIZE) return 0;
+
+  buffer[0] = CODEC_VERSION;
+  buffer[1] = command_msg->event_seqn & 0xFF;
+  buffer[2] = command_msg->event_seqn >> 8;
+  buffer[3] = command_msg->event_source;
+  buffer[4] = command_msg->receiver;
+  buffer[5] = command_msg->command;
+
+  n = varint_pack(&buffer[COMMAND_FIXED_SIZE], size - COMMAND_FIXED_SIZE,
+                  command_msg->threshold);
+  if (n == 0) return 0;
+
+  return COMMAND_FIXED_SIZE + n;
+}
+
+bool codec_command_unpack(struct command_msg_t *command_msg,
+                          const uint8_t *buffer, size_t length) {
+  /* Packed members could be unaligned */
+  uint32_t threshold;
+  size_t n;
+
+  if (length < COMMAND_FIXED_SIZE || buffer[0] != CODEC_VERSION) return false;
+
+  command_msg->event_seqn = buffer[1] | (uint16_t)buffer[2] << 8;
+  command_msg->event_source = buffer[3];
+  command_msg->receiver = buffer[4];
+  command_msg->command = buffer[5];
+
+  n = varint_unpack(&threshold, &buffer[COMMAND_FIXED_SIZE],
+                    length - COMMAND_FIXED_SIZE);
+  command_msg->threshold = threshold;
+
+  /* Trailing bytes */
+  return n != 0 && COMMAND_FIXED_SIZE + n == length;
+}
+
+/* --- ROUND END --- */
+size_t codec_round_end_pack(uint8_t *buffer, size_t size,
+                            const struct round_end_msg_t *round_end_msg) {
+  const struct command_entry_t *command;
+  size_t length = ROUND_END_FIXED_SIZE;
+  size_t n;
+  size_t i;
+
+  if (size < ROUND_END_FIXED_SIZE) return 0;
+
+  buffer[0] = CODEC_VERSION;
+  buffer[1] = round_end_msg->event_seqn & 0xFF;
+  buffer[2] = round_end_msg->event_seqn >> 8;
+  buffer[3] = round_end_msg->event_source;
+  memcpy(&buffer[4], round_end_msg->collected, CONNECTION_SUBTREE_SIZE);
+  buffer[4 + CONNECTION_SUBTREE_SIZE] = round_end_msg->num_commands;
+
+  for (i = 0; i < round_end_msg->num_commands; ++i) {
+    command = &round_end_msg->commands[i];
+
+    if (size - length < 2) return 0;
+    buffer[length++] = command->receiver;
+    buffer[length++] = command->command;
+
+    n = varint_pack(&buffer[length], size - length, command->threshold);
+    if (n == 0) return 0;
+    length += n;
+  }
+
+  return length;
+}
+
+bool codec_round_end_unpack(struct round_end_msg_t *round_end_msg,
+                            const uint8_t *buffer, size_t length) {
+  struct command_entry_t *command;
+  size_t offset = ROUND_END_FIXED_SIZE;
+  /* Packed members could be unaligned */
+  uint32_t threshold;
+  size_t n;
+  size_t i;
+
+  if (length < ROUND_END_FIXED_SIZE || buffer[0] != CODEC_VERSION)
+    return false;
+
+  round_end_msg->event_seqn = buffer[1] | (uint16_t)buffer[2] << 8;
+  round_end_msg->event_source = buffer[3];
+  memcpy(round_end_msg->collected, &buffer[4], CONNECTION_SUBTREE_SIZE);
+  round_end_msg->num_commands = buffer[4 + CONNECTION_SUBTREE_SIZE];
+
+  if (round_end_msg->num_commands > ETC_COMMAND_BUNDLE_MAX_SIZE) return false;
+
+  for (i = 0; i < round_end_msg->num_commands; ++i) {
+    command = &round_end_msg->commands[i];
+
+    if (length - offset < 2) return false;
+    command->receiver = buffer[offset++];
+    command->command = buffer[offset++];
+
+    n = varint_unpack(&threshold, &buffer[offset], length - offset);
+    if (n == 0) return false;
+    command->threshold = threshold;
+    offset += n;
+  }
+
+  /* Trailing bytes */
+  return offset == length;
+}
+
+/* --- VARINT --- */
+static size_t varint_pack(uint8_t *buffer, size_t size, uint32_t value) {
+  size_t length = 0;
+
+  do {
+    if (length >= size) return 0;
+    buffer[length] = value & 0x7F;
+    value >>= 7;
+    if (value != 0) buffer[length] |= 0x80;
+    length += 1;
+  } while (value != 0);
+
+  return length;
+}
+
+static size_t varint_unpack(uint32_t *value, const uint8_t *buffer,
+                            size_t length) {
+  size_t i;
+
+  *value = 0;
+  for (i = 0; i < length && i < CODEC_VARINT_MAX_SIZE; ++i) {
+    /* Last byte holds the 4 most significant bits (overflow) */
+    if (i == CODEC_VARINT_MAX_SIZE - 1 && buffer[i] > 0x0F) return 0;
+    *value |= (uint32_t)(buffer[i] & 0x7F) << (7 * i);
+    if (!(buffer[i] & 0x80)) return i + 1;
+  }
+
+  /* Truncated or too long */
+  return 0;
+}
@@ -0,0 +1,99 @@
+#ifndef _CONNECTION_CODEC_H_
+#define _CONNECTION_CODEC_H_
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "connection/connection.h"
+
+/**
+ * @brief Wire encoding version.
+ * First byte of every encoded message, a message with a different version is
+ * discarded.
+ */
+#define CODEC_VERSION (1)
+
+/**
+ * @brief Maximum size in byte of an encoded 32 bit value.
+ */
+#define CODEC_VARINT_MAX_SIZE (5)
+
+/**
+ * @brief Encode a collect message.
+ * Layout: version, event_seqn (2 byte, little endian), event_source,
+ * unchanged bitmap, num_readings and, for each reading, sender, hops, value
+ * and threshold (varint).
+ *
+ * @param buffer Destination buffer.
+ * @param size Buffer size in byte.
+ * @param collect_msg Collect message.
+ * @return Encoded size in byte, 0 if the buffer is too small.
+ */
+size_t codec_collect_pack(uint8_t *buffer, size_t size,
+                          const struct collect_msg_t *collect_msg);
+
+/**
+ * @brief Decode a collect message.
+ *
+ * @param collect_msg Collect message.
+ * @param buffer Source buffer.
+ * @param length Encoded size in byte.
+ * @return true Decoded.
+ * @return false Malformed (e.g. varint overflowing 32 bit), truncated or
+ * different version.
+ */
+bool codec_collect_unpack(struct collect_msg_t *collect_msg,
+                          const uint8_t *buffer, size_t length);
+
+/**
+ * @brief Encode a command message.
+ * Layout: version, event_seqn (2 byte, little endian), event_source,
+ * receiver, command (1 byte) and threshold (varint).
+ *
+ * @param buffer Destination buffer.
+ * @param size Buffer size in byte.
+ * @param command_msg Command message.
+ * @return Encoded size in byte, 0 if the buffer is too small.
+ */
+size_t codec_command_pack(uint8_t *buffer, size_t size,
+                          const struct command_msg_t *command_msg);
+
+/**
+ * @brief Decode a command message.
+ *
+ * @param command_msg Command message.
+ * @param buffer Source buffer.
+ * @param length Encoded size in byte.
+ * @return true Decoded.
+ * @return false Malformed, truncated or different version.
+ */
+bool codec_command_unpack(struct command_msg_t *command_msg,
+                          const uint8_t *buffer, size_t length);
+
+/**
+ * @brief Encode a round end message.
+ * Layout: version, event_seqn (2 byte, little endian), event_source,
+ * collected bitmap, num_commands and, for each command, receiver, command
+ * (1 byte) and threshold (varint).
+ *
+ * @param buffer Destination buffer.
+ * @param size Buffer size in byte.
+ * @param round_end_msg Round end message.
+ * @return Encoded size in byte, 0 if the buffer is too small.
+ */
+size_t codec_round_end_pack(uint8_t *buffer, size_t size,
+                            const struct round_end_msg_t *round_end_msg);
+
+/**
+ * @brief Decode a round end message.
+ *
+ * @param round_end_msg Round end message.
+ * @param buffer Source buffer.
+ * @param length Encoded size in byte.
+ * @return true Decoded.
+ * @return false Malformed, truncated or different version.
+ */
+bool codec_round_end_unpack(struct round_end_msg_t *round_end_msg,
+                            const uint8_t *buffer, size_t length);
+
+#endif
@@ -4,12 +4,16 @@
 #include <net/rime/broadcast.h>
 #include <net/rime/unicast.h>
 
+#include "advertisement.h"
 #include "beacon.h"
+#include "codec.h"
 #include "config/config.h"
 #include "connection/uc_buffer.h"
 #include "forward.h"
 #include "logger/logger.h"
+#include "neighbor.h"
 #include "node/node.h"
+#include "registry.h"
 
 /**
  * @brief Connection callbacks pointer.
@@ -19,11 +23,11 @@ static const struct connection_callbacks_t *cb;
 /**
  * @brief Invalidate first hop of the sensor.
  *
- * @param sensor Sensor address.
+ * @param sensor Sensor slot.
  * @return true New hop available.
  * @return false No hop available.
  */
-static bool invalidate_hop(const linkaddr_t *sensor);
+static bool invalidate_hop(uint8_t sensor);
 
 /* --- BROADCAST --- */
 /**
@@ -77,15 +81,13 @@ static struct unicast_conn uc_conn;
 static struct ctimer uc_buffer_send_timer;
 
 /**
- * @brief Send a unicast message to receiver address.
+ * @brief Send a buffered unicast message to its receiver address.
  *
- * @param uc_header Header.
- * @param receiver Receiver address.
+ * @param message Buffered message.
  * @return true Message sent.
  * @return false Message not sent due to an error.
  */
-static bool uc_send(const struct unicast_hdr_t *uc_header,
-                    const linkaddr_t *receiver);
+static bool uc_send(struct uc_buffer_t *message);
 
 /**
  * @brief Unicast receive callback.
@@ -113,6 +115,7 @@ static void uc_buffer_send_timer_cb(void *ignored);
 
 /**
  * @brief Send next message in buffer (if any).
+ * Must be called only when no message is in flight.
  */
 static void uc_send_next(void);
 
@@ -123,11 +126,6 @@ static const struct unicast_callbacks uc_cb = {.recv = uc_recv_cb,
                                                .sent = uc_sent_cb};
 
 /* --- FORWARD DISCOVERY --- */
-/**
- * @brief Forward discovery timer.
- */
-static struct ctimer forward_discovery_timer;
-
 /**
  * @brief Broadcast receive callback for a forward discovery message.
  *
@@ -138,11 +136,11 @@ static void forward_discovery_recv_cb(const struct broadcast_hdr_t *bc_header,
                                       const linkaddr_t *sender);
 
 /**
- * @brief Forward delivery timer callback.
+ * @brief Forward discovery timer callback.
  *
- * @param ignored
+ * @param ptr Buffered message waiting for the discovery.
  */
-static void forward_discovery_timer_cb(void *ignored);
+static void forward_discovery_timer_cb(void *ptr);
 
 /* --- --- */
 void connection_open(uint16_t channel,
@@ -152,15 +150,24 @@ void connection_open(uint16_t channel,
   /* Initialize unicast buffer */
   uc_buffer_init();
 
+  /* Initialize registry */
+  registry_init();
+
   /* Initialize forward structure */
   forward_init();
 
+  /* Initialize neighbor table */
+  neighbor_init();
+
   /* Open the underlying rime primitives */
   broadcast_open(&bc_conn, channel, &bc_cb);
   unicast_open(&uc_conn, channel + 1, &uc_cb);
 
   /* Initialize beacon */
   beacon_init();
+
+  /* Initialize advertisement */
+  advertisement_init();
 }
 
 void connection_close(void) {
@@ -168,20 +175,28 @@ void connection_close(void) {
 
   /* Stop timer  */
   ctimer_stop(&uc_buffer_send_timer);
-  ctimer_stop(&forward_discovery_timer);
 
   /* Terminate unicast buffer */
   uc_buffer_terminate();
 
+  /* Terminate registry */
+  registry_terminate();
+
   /* Terminate forward structure */
   forward_terminate();
 
+  /* Terminate neighbor table */
+  neighbor_terminate();
+
   /* Close the underlying rime primitives */
   broadcast_close(&bc_conn);
   unicast_close(&uc_conn);
 
   /* Terminate beacon */
   beacon_terminate();
+
+  /* Terminate advertisement */
+  advertisement_terminate();
 }
 
 bool connection_is_connected(void) {
@@ -200,8 +215,8 @@ bool connection_invalidate(void) {
 
   LOG_WARN(
       "Invalidating connection: "
-      "{ parent_node: %02x:%02x, seqn: %u, hopn: %u, rssi: %d }",
-      conn->parent_node.u8[0], conn->parent_node.u8[1], conn->seqn, conn->hopn,
+      "{ parent_node: %02x:%02x, hopn: %u, etx: %u, rssi: %d }",
+      conn->parent_node.u8[0], conn->parent_node.u8[1], conn->hopn, conn->etx,
       conn->rssi);
 
   /* Invalidate */
@@ -217,23 +232,22 @@ bool connection_invalidate(void) {
   const struct connection_t *new_conn = connection_get_conn();
   LOG_INFO(
       "Backup connection: "
-      "{ parent_node: %02x:%02x, seqn: %u, hopn: %u, rssi: %d }",
-      new_conn->parent_node.u8[0], new_conn->parent_node.u8[1], new_conn->seqn,
-      new_conn->hopn, new_conn->rssi);
+      "{ parent_node: %02x:%02x, hopn: %u, etx: %u, rssi: %d }",
+      new_conn->parent_node.u8[0], new_conn->parent_node.u8[1], new_conn->hopn,
+      new_conn->etx, new_conn->rssi);
 
   return true;
 }
 
-static bool invalidate_hop(const linkaddr_t *sensor) {
+static bool invalidate_hop(uint8_t sensor) {
   /* Find a forward node */
   const struct forward_t *forward = forward_find(sensor);
   if (forward == NULL) return false;
 
   if (forward_hops_length(sensor) != 0) {
-    LOG_WARN("Invalidating hop %02x:%02x with distance %u for sensor %02x:%02x",
+    LOG_WARN("Invalidating hop %02x:%02x with distance %u for sensor %u",
              forward->hops[0].address.u8[0], forward->hops[0].address.u8[1],
-             forward->hops[0].distance, forward->sensor.u8[0],
-             forward->sensor.u8[1]);
+             forward->hops[0].distance, sensor);
   }
 
   /* Remove broken forward for final receiver */
@@ -244,18 +258,16 @@ static bool invalidate_hop(const linkaddr_t *sensor) {
   if (new_forward == NULL) return false;
 
   /* Check no hop available */
-  if (forward_hops_length(&new_forward->sensor) == 0) {
-    LOG_WARN("No hop available for sensor %02x:%02x", new_forward->sensor.u8[0],
-             new_forward->sensor.u8[1]);
+  if (forward_hops_length(sensor) == 0) {
+    LOG_WARN("No hop available for sensor %u", sensor);
     return false;
   }
 
   /* Hop available */
-  LOG_INFO(
-      "Available backup hop %02x:%02x with distance %u for sensor %02x:%02x",
-      new_forward->hops[0].address.u8[0], new_forward->hops[0].address.u8[1],
-      new_forward->hops[0].distance, new_forward->sensor.u8[0],
-      new_forward->sensor.u8[1]);
+  LOG_INFO("Available backup hop %02x:%02x with distance %u for sensor %u",
+           new_forward->hops[0].address.u8[0],
+           new_forward->hops[0].address.u8[1], new_forward->hops[0].distance,
+           sensor);
   return true;
 }
 
@@ -323,6 +335,11 @@ static void bc_recv_cb(struct broadcast_conn *bc_conn,
       forward_discovery_recv_cb(&bc_header, sender);
       break;
     }
+    case BROADCAST_MSG_TYPE_REGISTRY: {
+      /* Forward to registry */
+      registry_recv_cb(&bc_header, sender);
+      break;
+    }
     default: {
       /* Forward to callback */
       if (cb->bc.recv != NULL) cb->bc.recv(&bc_header, sender);
@@ -343,39 +360,43 @@ static void bc_sent_cb(struct broadcast_conn *bc_conn, int status, int num_tx) {
 }
 
 /* --- UNICAST --- */
-static bool uc_send(const struct unicast_hdr_t *uc_header,
-                    const linkaddr_t *receiver) {
+static bool uc_send(struct uc_buffer_t *message) {
+  /* Prepare packetbuf */
+  packetbuf_clear();
+  packetbuf_copyfrom(message->data, message->data_len);
+
   /* Allocate header space */
-  if (!packetbuf_hdralloc(sizeof(struct unicast_hdr_t))) {
+  if (!packetbuf_hdralloc(UNICAST_HDR_SIZE(message->header.route_length))) {
     /* Insufficient space */
     LOG_ERROR("Error allocating unicast header");
     return false;
   }
 
   /* Copy header */
-  memcpy(packetbuf_hdrptr(), uc_header, sizeof(struct unicast_hdr_t));
+  memcpy(packetbuf_hdrptr(), &message->header,
+         UNICAST_HDR_SIZE(message->header.route_length));
 
   /* Send */
-  const bool ret = unicast_send(&uc_conn, receiver);
+  const bool ret = unicast_send(&uc_conn, &message->receiver);
 
   if (!ret) {
     LOG_ERROR(
         "Error sending unicast message to %02x:%02x: { type: %d, hops: %u }",
-        receiver->u8[0], receiver->u8[1], uc_header->type, uc_header->hops);
-    /* Remove message from buffer */
-    uc_buffer_remove();
+        message->receiver.u8[0], message->receiver.u8[1],
+        message->header.type, message->header.hops);
   } else {
     LOG_DEBUG("Sending unicast message to %02x:%02x: { type: %d, hops: %u }",
-              receiver->u8[0], receiver->u8[1], uc_header->type,
-              uc_header->hops);
+              message->receiver.u8[0], message->receiver.u8[1],
+              message->header.type, message->header.hops);
     /* Increase send counter */
-    uc_buffer_first()->num_send += 1;
+    message->num_send += 1;
   }
   return ret;
 }
 
 bool connection_unicast_send(const struct unicast_hdr_t *uc_header,
-                             const linkaddr_t *receiver) {
+                             const linkaddr_t *receiver,
+                             clock_time_t deadline) {
   /* Check if null address */
   if (linkaddr_cmp(receiver, &linkaddr_null)) {
     LOG_WARN("Unable to send unicast message: NULL address: %02x:%02x",
@@ -391,34 +412,52 @@ bool connection_unicast_send(const struct unicast_hdr_t *uc_header,
   }
 
   /* Add to buffer */
-  if (!uc_buffer_add(uc_header, receiver)) {
+  if (!uc_buffer_add(uc_header, receiver, deadline)) {
     LOG_ERROR(
         "Unicast buffer is full, message of type %d to %02x:%02x not sent",
         uc_header->type, receiver->u8[0], receiver->u8[1]);
     return false;
   }
 
-  /* Start sending if first in buffer */
-  if (uc_buffer_length() - 1 == 0) return uc_send(uc_header, receiver);
+  /* Start sending if idle */
+  if (uc_buffer_current() == NULL) uc_send_next();
 
   return true;
 }
 
+void connection_unicast_purge(uint16_t event_seqn, uint8_t event_source) {
+  uc_buffer_purge_event(event_seqn, event_source);
+}
+
 static void uc_recv_cb(struct unicast_conn *uc_conn, const linkaddr_t *sender) {
   struct unicast_hdr_t uc_header;
+  bool source_routed;
+  size_t i;
 
   /* Check received unicast message validity */
-  if (packetbuf_datalen() < sizeof(uc_header)) {
+  if (packetbuf_datalen() < UNICAST_HDR_SIZE(0)) {
     LOG_ERROR("Unicast message from %02x:%02x wrong size: %u byte",
               sender->u8[0], sender->u8[1], packetbuf_datalen());
     return;
   }
 
   /* Copy header */
-  memcpy(&uc_header, packetbuf_dataptr(), sizeof(uc_header));
+  memcpy(&uc_header, packetbuf_dataptr(), UNICAST_HDR_SIZE(0));
+
+  /* Check route */
+  if (uc_header.route_length > CONNECTION_ROUTE_MAX_SIZE ||
+      packetbuf_datalen() < UNICAST_HDR_SIZE(uc_header.route_length)) {
+    LOG_ERROR("Unicast message from %02x:%02x wrong route length: %u",
+              sender->u8[0], sender->u8[1], uc_header.route_length);
+    return;
+  }
+
+  /* Copy route */
+  memcpy(&uc_header, packetbuf_dataptr(),
+         UNICAST_HDR_SIZE(uc_header.route_length));
 
   /* Reduce header in packetbuf */
-  if (!packetbuf_hdrreduce(sizeof(uc_header))) {
+  if (!packetbuf_hdrreduce(UNICAST_HDR_SIZE(uc_header.route_length))) {
     LOG_ERROR("Error reducing unicast header");
     return;
   }
@@ -426,6 +465,41 @@ static void uc_recv_cb(struct unicast_conn *uc_conn, const linkaddr_t *sender) {
   /* Increase hop counter */
   uc_header.hops += 1;
 
+  /* Update route */
+  source_routed = false;
+  switch (uc_header.type) {
+    case UNICAST_MSG_TYPE_COLLECT: {
+      /* Record sender, drop oldest if full */
+      if (uc_header.route_length >= CONNECTION_ROUTE_MAX_SIZE) {
+        for (i = 1; i < CONNECTION_ROUTE_MAX_SIZE; ++i)
+          linkaddr_copy(&uc_header.route[i - 1], &uc_header.route[i]);
+        uc_header.route_length = CONNECTION_ROUTE_MAX_SIZE - 1;
+      }
+      linkaddr_copy(&uc_header.route[uc_header.route_length], sender);
+      uc_header.route_length += 1;
+      break;
+    }
+    case UNICAST_MSG_TYPE_COMMAND: {
+      /* Pop me */
+      if (uc_header.route_length > 0) {
+        source_routed = true;
+        if (!linkaddr_cmp(&uc_header.route[0], &linkaddr_node_addr)) {
+          LOG_WARN("Source route does not start with me, dropping route");
+          uc_header.route_length = 0;
+          break;
+        }
+        for (i = 1; i < uc_header.route_length; ++i)
+          linkaddr_copy(&uc_header.route[i - 1], &uc_header.route[i]);
+        uc_header.route_length -= 1;
+      }
+      break;
+    }
+    default: {
+      /* No route */
+      break;
+    }
+  }
+
   LOG_DEBUG("Received unicast message from %02x:%02x: { type: %d, hops: %d }",
             sender->u8[0], sender->u8[1], uc_header.type, uc_header.hops);
 
@@ -453,21 +527,36 @@ static void uc_recv_cb(struct unicast_conn *uc_conn, const linkaddr_t *sender) {
       break;
     }
     case UNICAST_MSG_TYPE_COMMAND: {
+      /* Source route is loop free */
+      if (source_routed) break;
+
       struct command_msg_t command_msg;
-      packetbuf_copyto(&command_msg);
-      const struct forward_t *forward = forward_find(&command_msg.receiver);
+      if (!codec_command_unpack(&command_msg, packetbuf_dataptr(),
+                                packetbuf_datalen()))
+        break;
+      const struct forward_t *forward = forward_find(command_msg.receiver);
 
       /* Check sender is not hop */
-      if (linkaddr_cmp(sender, &forward->hops[0].address)) {
+      if (forward != NULL && linkaddr_cmp(sender, &forward->hops[0].address)) {
         LOG_WARN(
             "Loop detected: Received command message from hop "
             "%02x:%02x",
             sender->u8[0], sender->u8[1]);
         /* Invalidate hop */
-        invalidate_hop(&command_msg.receiver);
+        invalidate_hop(command_msg.receiver);
       }
       break;
     }
+    case UNICAST_MSG_TYPE_ADVERTISEMENT: {
+      /* Forward to advertisement */
+      advertisement_recv_cb(&uc_header, sender);
+      return;
+    }
+    case UNICAST_MSG_TYPE_JOIN: {
+      /* Forward to registry */
+      registry_join_recv_cb(&uc_header, sender);
+      return;
+    }
   }
 
   /* Forward to callback */
@@ -478,7 +567,19 @@ static void uc_sent_cb(struct unicast_conn *uc_conn, int status, int num_tx) {
   /* Receiver address */
   const linkaddr_t *receiver = packetbuf_addr(PACKETBUF_ADDR_RECEIVER);
   /* Obtain buffered message */
-  struct uc_buffer_t *message = uc_buffer_first();
+  struct uc_buffer_t *message = uc_buffer_current();
+
+  /* Update link estimation */
+  if (!linkaddr_cmp(receiver, &linkaddr_null)) {
+    neighbor_update_tx(receiver, status == MAC_TX_OK, num_tx);
+    beacon_update_connections();
+  }
+
+  /* Check buffered message */
+  if (message == NULL) {
+    LOG_WARN("Unicast message sent but buffer is empty");
+    return;
+  }
 
   /* Check if null address */
   if (linkaddr_cmp(receiver, &linkaddr_null)) {
@@ -527,11 +628,8 @@ static void uc_sent_cb(struct unicast_conn *uc_conn, int status, int num_tx) {
           break;
         }
         case UNICAST_MSG_TYPE_COMMAND: {
-          const struct command_msg_t *command_msg =
-              (struct command_msg_t *)message->data;
-
           /* Ignore if handle NULL */
-          if (linkaddr_cmp(&command_msg->receiver, &linkaddr_null)) break;
+          if (message->destination == REGISTRY_SLOT_NONE) break;
 
           /* Give a last chance */
           if (!message->last_chance) {
@@ -540,8 +638,16 @@ static void uc_sent_cb(struct unicast_conn *uc_conn, int status, int num_tx) {
             break;
           }
 
-          /* Invalidate hop */
-          invalidate_hop(&command_msg->receiver);
+          if (message->header.route_length > 0) {
+            /* Source route broken: fall back to forwarding rules */
+            LOG_WARN("Source route for sensor %u is broken",
+                     message->destination);
+            message->header.route_length = 0;
+            forward_clear_route(message->destination);
+          } else {
+            /* Invalidate hop */
+            invalidate_hop(message->destination);
+          }
 
           /* Try with new hop or prepare to discovery */
           retry = true;
@@ -549,6 +655,14 @@ static void uc_sent_cb(struct unicast_conn *uc_conn, int status, int num_tx) {
 
           break;
         }
+        case UNICAST_MSG_TYPE_ADVERTISEMENT: {
+          /* Sent again on parent change or refresh */
+          break;
+        }
+        case UNICAST_MSG_TYPE_JOIN: {
+          /* Sent again until registered */
+          break;
+        }
       }
     }
 
@@ -562,7 +676,7 @@ static void uc_sent_cb(struct unicast_conn *uc_conn, int status, int num_tx) {
     LOG_DEBUG("Sent unicast message to %02x:%02x", receiver->u8[0],
               receiver->u8[1]);
     /* Remove entry */
-    uc_buffer_remove();
+    uc_buffer_remove(message);
     /* Forward to callback */
     if (cb->uc.sent != NULL) cb->uc.sent(true);
   }
@@ -572,23 +686,21 @@ static void uc_sent_cb(struct unicast_conn *uc_conn, int status, int num_tx) {
 
 static void uc_buffer_send_timer_cb(void *ignored) {
   /* Obtain buffered message */
-  const struct uc_buffer_t *message = uc_buffer_first();
+  struct uc_buffer_t *message = uc_buffer_current();
 
-  /* Prepare packetbuf */
-  packetbuf_clear();
-  packetbuf_copyfrom(message->data, message->data_len);
+  if (message == NULL) return;
 
   /* Try sending */
-  if (!uc_send(&message->header, &message->receiver)) {
+  if (!uc_send(message)) {
     LOG_ERROR(
         "Error sending buffered unicast message: "
         "{ receiver: %02x:%02x, type: %d, num_send: %u }",
         message->receiver.u8[0], message->receiver.u8[1], message->header.type,
         message->num_send);
+    /* Remove entry */
+    uc_buffer_remove(message);
     /* Forward to callback */
     if (cb->uc.sent != NULL) cb->uc.sent(false);
-    /* Remove entry */
-    uc_buffer_remove();
     /* Next */
     uc_send_next();
   } else {
@@ -602,10 +714,23 @@ static void uc_buffer_send_timer_cb(void *ignored) {
 }
 
 static void uc_send_next(void) {
+  struct uc_buffer_t *message;
+
   /* Send message in buffer (if any) */
-  while (!uc_bufffer_is_empty()) {
-    /* Obtain buffered message */
-    struct uc_buffer_t *message = uc_buffer_first();
+  while ((message = uc_buffer_next()) != NULL) {
+    /* Deadline passed */
+    if (uc_buffer_is_expired(message)) {
+      LOG_WARN(
+          "Buffered message could not be sent because its deadline has "
+          "passed: { receiver: %02x:%02x, type: %d }",
+          message->receiver.u8[0], message->receiver.u8[1],
+          message->header.type);
+      /* Remove entry */
+      uc_buffer_remove(message);
+      /* Forward to callback */
+      if (cb->uc.sent != NULL) cb->uc.sent(false);
+      continue;
+    }
 
     /* No last chance and maximum number of send */
     if (!message->last_chance &&
@@ -616,7 +741,7 @@ static void uc_send_next(void) {
           message->receiver.u8[0], message->receiver.u8[1],
           message->header.type);
       /* Remove entry */
-      uc_buffer_remove();
+      uc_buffer_remove(message);
       /* Forward to callback */
       if (cb->uc.sent != NULL) cb->uc.sent(false);
       continue;
@@ -624,7 +749,9 @@ static void uc_send_next(void) {
 
     /* Logic */
     switch (message->header.type) {
-      case UNICAST_MSG_TYPE_COLLECT: {
+      case UNICAST_MSG_TYPE_COLLECT:
+      case UNICAST_MSG_TYPE_ADVERTISEMENT:
+      case UNICAST_MSG_TYPE_JOIN: {
         /* If disconnected no collect message could be sent */
         if (!connection_is_connected()) {
           LOG_WARN(
@@ -633,7 +760,7 @@ static void uc_send_next(void) {
               message->receiver.u8[0], message->receiver.u8[1],
               message->header.type);
           /* Remove entry */
-          uc_buffer_remove();
+          uc_buffer_remove(message);
           /* Forward to callback */
           if (cb->uc.sent != NULL) cb->uc.sent(false);
           continue;
@@ -644,19 +771,24 @@ static void uc_send_next(void) {
         break;
       }
       case UNICAST_MSG_TYPE_COMMAND: {
-        const struct command_msg_t *command_msg =
-            (struct command_msg_t *)message->data;
-        const struct forward_t *forward = forward_find(&command_msg->receiver);
+        const struct forward_t *forward = forward_find(message->destination);
+
+        /* Source route, update receiver (next hop) */
+        if (message->header.route_length > 0) {
+          linkaddr_copy(&message->receiver, &message->header.route[0]);
+          break;
+        }
+
         if (forward == NULL) break;
 
         /* If no available hop try to find one */
-        if (forward_hops_length(&forward->sensor) == 0) {
+        if (forward_hops_length(message->destination) == 0) {
           /* Hop not available */
           LOG_WARN("No hop available: try to find one...");
 
           /* Prepare forward discovery message */
           struct forward_discovery_msg_t fd_msg;
-          linkaddr_copy(&fd_msg.sensor, &forward->sensor);
+          fd_msg.sensor = message->destination;
           fd_msg.distance = UINT8_MAX;
 
           /* Try to discover a forward node */
@@ -667,25 +799,25 @@ static void uc_send_next(void) {
           if (!bc_send(BROADCAST_MSG_TYPE_FORWARD_DISCOVERY_REQUEST)) {
             LOG_ERROR(
                 "Error sending forward discovery request message for sensor "
-                "%02x:%02x",
-                forward->sensor.u8[0], forward->sensor.u8[1]);
+                "%u",
+                fd_msg.sensor);
             /* Remove entry */
-            uc_buffer_remove();
+            uc_buffer_remove(message);
             /* Forward to callback */
             if (cb->uc.sent != NULL) cb->uc.sent(false);
             continue;
           }
 
           /* Sent */
-          LOG_INFO(
-              "Sending forward discovery request message for sensor "
-              "%02x:%02x",
-              forward->sensor.u8[0], forward->sensor.u8[1]);
-          /* Start forward discovery timeout */
-          ctimer_set(&forward_discovery_timer,
+          LOG_INFO("Sending forward discovery request message for sensor %u",
+                   fd_msg.sensor);
+          /* Block virtual queue until forward discovery timeout */
+          message->discovering = true;
+          ctimer_set(&message->discovery_timer,
                      CONNECTION_FORWARD_DISCOVERY_TIMEOUT,
-                     forward_discovery_timer_cb, NULL);
-          return;
+                     forward_discovery_timer_cb, message);
+          /* Serve other virtual queues meanwhile */
+          continue;
         }
 
         /* Hop available, update receiver (hop node) */
@@ -730,55 +862,51 @@ static void forward_discovery_recv_cb(const struct broadcast_hdr_t *bc_header,
 
   LOG_INFO(
       "Received forward discovery message of type %d from %02x:%02x: "
-      "{ sensor: %02x:%02x, distance: %u }",
-      bc_header->type, sender->u8[0], sender->u8[1], fd_msg.sensor.u8[0],
-      fd_msg.sensor.u8[1], fd_msg.distance);
+      "{ sensor: %u, distance: %u }",
+      bc_header->type, sender->u8[0], sender->u8[1], fd_msg.sensor,
+      fd_msg.distance);
 
   /* Logic */
   switch (bc_header->type) {
     case BROADCAST_MSG_TYPE_FORWARD_DISCOVERY_REQUEST: {
+      const bool me = fd_msg.sensor == registry_find(&linkaddr_node_addr);
+
       /* Ignore if sensor is not me and not known */
-      if (!linkaddr_cmp(&fd_msg.sensor, &linkaddr_node_addr) &&
-          forward_hops_length(&fd_msg.sensor) == 0) {
-        LOG_WARN("Forward for sensor %02x:%02x is not known",
-                 fd_msg.sensor.u8[0], fd_msg.sensor.u8[1]);
+      if (!me && forward_hops_length(fd_msg.sensor) == 0) {
+        LOG_WARN("Forward for sensor %u is not known", fd_msg.sensor);
         return;
       }
 
-      if (linkaddr_cmp(&fd_msg.sensor, &linkaddr_node_addr)) {
+      if (me) {
         /* Sensor is me */
-        LOG_INFO("Forward for sensor %02x:%02x is me", fd_msg.sensor.u8[0],
-                 fd_msg.sensor.u8[1]);
+        LOG_INFO("Forward for sensor %u is me", fd_msg.sensor);
         /* Distance is 0 */
         fd_msg.distance = 0;
       } else {
-        const struct forward_t *forward = forward_find(&fd_msg.sensor);
+        const struct forward_t *forward = forward_find(fd_msg.sensor);
 
         /* If sender is my primary hop */
         if (linkaddr_cmp(sender, &forward->hops[0].address)) {
           /* Check if I know another hop */
           if (!linkaddr_cmp(&forward->hops[1].address, &linkaddr_null)) {
             LOG_INFO(
-                "Hop %02x:%02x for sensor %02x:%02x is my primary but "
-                "different hop is known: %02x:%02x",
-                sender->u8[0], sender->u8[1], forward->sensor.u8[0],
-                forward->sensor.u8[1], forward->hops[1].address.u8[0],
-                forward->hops[1].address.u8[1]);
+                "Hop %02x:%02x for sensor %u is my primary but different hop "
+                "is known: %02x:%02x",
+                sender->u8[0], sender->u8[1], fd_msg.sensor,
+                forward->hops[1].address.u8[0], forward->hops[1].address.u8[1]);
             /* Distance is at hop 1 */
             fd_msg.distance = forward->hops[1].distance;
           } else {
             /* No other hop known */
             LOG_INFO(
-                "Hop %02x:%02x for sensor %02x:%02x is my primary and no other "
-                "hop is known",
-                sender->u8[0], sender->u8[1], forward->sensor.u8[0],
-                forward->sensor.u8[1]);
+                "Hop %02x:%02x for sensor %u is my primary and no other hop is "
+                "known",
+                sender->u8[0], sender->u8[1], fd_msg.sensor);
             return;
           }
         } else {
           /* Known */
-          LOG_INFO("Forward for sensor %02x:%02x is known", fd_msg.sensor.u8[0],
-                   fd_msg.sensor.u8[1]);
+          LOG_INFO("Forward for sensor %u is known", fd_msg.sensor);
           /* Distance is at hop 0 */
           fd_msg.distance = forward->hops[0].distance;
         }
@@ -791,19 +919,17 @@ static void forward_discovery_recv_cb(const struct broadcast_hdr_t *bc_header,
       /* Try send */
       if (!bc_send(BROADCAST_MSG_TYPE_FORWARD_DISCOVERY_RESPONSE)) {
         LOG_ERROR(
-            "Error sending forward discovery response message for sensor "
-            "%02x:%02x to %02x:%02x",
-            fd_msg.sensor.u8[0], fd_msg.sensor.u8[1], sender->u8[0],
-            sender->u8[1]);
+            "Error sending forward discovery response message for sensor %u "
+            "to %02x:%02x",
+            fd_msg.sensor, sender->u8[0], sender->u8[1]);
         break;
       }
 
       /* Sent */
       LOG_INFO(
-          "Sending forward discovery response message for sensor "
-          "%02x:%02x to %02x:%02x",
-          fd_msg.sensor.u8[0], fd_msg.sensor.u8[1], sender->u8[0],
-          sender->u8[1]);
+          "Sending forward discovery response message for sensor %u to "
+          "%02x:%02x",
+          fd_msg.sensor, sender->u8[0], sender->u8[1]);
       break;
     }
     case BROADCAST_MSG_TYPE_FORWARD_DISCOVERY_RESPONSE: {
@@ -811,37 +937,23 @@ static void forward_discovery_recv_cb(const struct broadcast_hdr_t *bc_header,
       fd_msg.distance += 1;
 
       /* Learn */
-      forward_add(&fd_msg.sensor, sender, fd_msg.distance);
+      forward_add(fd_msg.sensor, sender, fd_msg.distance);
       /* Sort */
-      forward_sort(&fd_msg.sensor);
-
-      /* Ignore if timer expired */
-      if (ctimer_expired(&forward_discovery_timer)) {
-        LOG_WARN(
-            "Ignoring forward discovery response from %02x:%02x beacuse the "
-            "timer has expired",
-            sender->u8[0], sender->u8[1]);
-        return;
-      }
-
-      const struct command_msg_t *command_msg =
-          (struct command_msg_t *)uc_buffer_first()->data;
+      forward_sort(fd_msg.sensor);
 
-      /* Check request and response match */
-      if (!linkaddr_cmp(&command_msg->receiver, &fd_msg.sensor)) {
+      /* Ignore if no forward discovery in progress for the sensor */
+      if (uc_buffer_find_discovering(fd_msg.sensor) == NULL) {
         LOG_WARN(
-            "Forward discovery response has wrong sensor: request is %02x:%02x "
-            "but response is %02x:%02x",
-            command_msg->receiver.u8[0], command_msg->receiver.u8[1],
-            fd_msg.sensor.u8[0], fd_msg.sensor.u8[1]);
+            "Ignoring forward discovery response from %02x:%02x for sensor %u "
+            "because no discovery is in progress",
+            sender->u8[0], sender->u8[1], fd_msg.sensor);
         return;
       }
 
       LOG_INFO(
           "Forward discovery response from %02x:%02x with distance %u for "
-          "sensor %02x:%02x",
-          sender->u8[0], sender->u8[1], fd_msg.distance,
-          command_msg->receiver.u8[0], command_msg->receiver.u8[1]);
+          "sensor %u",
+          sender->u8[0], sender->u8[1], fd_msg.distance, fd_msg.sensor);
       break;
     }
     default: {
@@ -851,29 +963,30 @@ static void forward_discovery_recv_cb(const struct broadcast_hdr_t *bc_header,
   }
 }
 
-static void forward_discovery_timer_cb(void *ignored) {
-  const struct command_msg_t *command_msg =
-      (struct command_msg_t *)uc_buffer_first()->data;
-  const struct forward_t *forward = forward_find(&command_msg->receiver);
-  const size_t hops_length = forward_hops_length(&forward->sensor);
+static void forward_discovery_timer_cb(void *ptr) {
+  struct uc_buffer_t *message = (struct uc_buffer_t *)ptr;
+  const size_t hops_length = forward_hops_length(message->destination);
 
-  LOG_INFO("Forward discovery timer expired for sensor %02x:%02x",
-           forward->sensor.u8[0], forward->sensor.u8[1]);
-  LOG_INFO("Available hops for sensor %02x:%02x: %d", forward->sensor.u8[0],
-           forward->sensor.u8[1], hops_length);
+  LOG_INFO("Forward discovery timer expired for sensor %u",
+           message->destination);
+  LOG_INFO("Available hops for sensor %u: %d", message->destination,
+           hops_length);
+
+  /* Unblock virtual queue */
+  message->discovering = false;
 
   if (hops_length == 0) {
     LOG_WARN("Forward discovery failed");
     /* Remove entry */
-    uc_buffer_remove();
+    uc_buffer_remove(message);
     /* Forward to callback */
     if (cb->uc.sent != NULL) cb->uc.sent(false);
   } else {
     LOG_INFO("Forward discovery succeeded");
     /* Sort new hops */
-    forward_sort(&forward->sensor);
+    forward_sort(message->destination);
   }
 
-  /* Next unicast buffer */
-  uc_send_next();
+  /* Next unicast buffer only if idle */
+  if (uc_buffer_current() == NULL) uc_send_next();
 }
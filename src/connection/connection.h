@@ -3,8 +3,11 @@
 
 #include <net/linkaddr.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <sys/clock.h>
 #include <sys/types.h>
 
+#include "config/config.h"
 #include "node/node.h"
 
 /**
@@ -13,12 +16,12 @@
 struct connection_t {
   /* Parent node address. */
   linkaddr_t parent_node;
-  /* Sequence number. */
-  uint16_t seqn;
   /* Hop number. */
   uint16_t hopn;
+  /* Path ETX through parent node. */
+  uint16_t etx;
   /* RSSI parent node. */
-  uint16_t rssi;
+  int16_t rssi;
 };
 
 /* --- BROADCAST --- */
@@ -33,47 +36,115 @@ enum broadcast_msg_type_t {
   /* Forward discovery request. */
   BROADCAST_MSG_TYPE_FORWARD_DISCOVERY_REQUEST,
   /* Forward discovery response. */
-  BROADCAST_MSG_TYPE_FORWARD_DISCOVERY_RESPONSE
+  BROADCAST_MSG_TYPE_FORWARD_DISCOVERY_RESPONSE,
+  /* Registry message. */
+  BROADCAST_MSG_TYPE_REGISTRY,
+  /* Round end message. */
+  BROADCAST_MSG_TYPE_ROUND_END,
+  /* Collect request message. */
+  BROADCAST_MSG_TYPE_COLLECT_REQUEST
 };
 
 /**
  * @brief Broadcast header.
  */
 struct broadcast_hdr_t {
-  /* Type of message. */
-  enum broadcast_msg_type_t type;
+  /* Type of message (see enum broadcast_msg_type_t). */
+  uint8_t type;
 } __attribute__((packed));
 
 /**
  * @brief Beacon message.
  */
 struct beacon_msg_t {
-  /* Sequence number. */
-  uint16_t seqn;
   /* Hop number. */
   uint16_t hopn;
+  /* Path ETX to the Controller node. */
+  uint16_t etx;
+} __attribute__((packed));
+
+/**
+ * @brief Event priorities.
+ */
+enum event_priority_t {
+  /* Threshold crossing. */
+  EVENT_PRIORITY_NORMAL,
+  /* Value far past the threshold (see ETC_EVENT_CRITICAL_MARGIN). */
+  EVENT_PRIORITY_CRITICAL
+};
+
+/**
+ * @brief Sensor reading piggybacked on an event message.
+ */
+struct event_reading_t {
+  /* Slot of sender sensor node. */
+  uint8_t sender;
+  /* Node value. */
+  uint32_t value;
+  /* Node threshold. */
+  uint32_t threshold;
 } __attribute__((packed));
 
 /**
  * @brief Event message.
+ * Readings of the current event collected along the flood (see
+ * ETC_EVENT_PIGGYBACK).
+ * Only the first num_readings readings are sent (see EVENT_MSG_SIZE).
  */
 struct event_msg_t {
   /* Event sequence number. */
   uint16_t seqn;
-  /* Address of the sensor that generated the event. */
-  linkaddr_t source;
+  /* Slot of the sensor that generated the event. */
+  uint8_t source;
+  /* Priority (see enum event_priority_t). */
+  uint8_t priority;
+  /* Number of readings. */
+  uint8_t num_readings;
+  /* Readings. */
+  struct event_reading_t readings[ETC_EVENT_PIGGYBACK_MAX_SIZE];
 } __attribute__((packed));
 
+/**
+ * @brief Size in byte of an event message with num_readings readings.
+ */
+#define EVENT_MSG_SIZE(num_readings)        \
+  (offsetof(struct event_msg_t, readings) + \
+   (num_readings) * sizeof(struct event_reading_t))
+
 /**
  * @brief Forward discovery message.
  */
 struct forward_discovery_msg_t {
-  /* Sensor address. */
-  linkaddr_t sensor;
+  /* Sensor slot. */
+  uint8_t sensor;
   /* Hop distance. */
   uint8_t distance;
 };
 
+/**
+ * @brief Registry message.
+ * Flooded by the Controller node with the addresses of the registered Sensor
+ * nodes in slots [first_slot, first_slot + num_sensors).
+ * Only the first num_sensors addresses are sent (see REGISTRY_MSG_SIZE).
+ */
+struct registry_msg_t {
+  /* Flood sequence number. */
+  uint16_t seqn;
+  /* Slot of the first address. */
+  uint8_t first_slot;
+  /* Number of addresses. */
+  uint8_t num_sensors;
+  /* Sensor addresses. */
+  linkaddr_t sensors[CONNECTION_REGISTRY_CHUNK_SIZE];
+} __attribute__((packed));
+
+/**
+ * @brief Size in byte of a registry message with num_sensors addresses.
+ */
+#define REGISTRY_MSG_SIZE(num_sensors)        \
+  (offsetof(struct registry_msg_t, sensors) + \
+   (num_sensors) * sizeof(linkaddr_t))
+
 /* --- UNICAST --- */
 /**
  * @brief Unicast message types.
@@ -82,51 +153,167 @@ enum unicast_msg_type_t {
   /* Collect message. */
   UNICAST_MSG_TYPE_COLLECT,
   /* Command message. */
-  UNICAST_MSG_TYPE_COMMAND
+  UNICAST_MSG_TYPE_COMMAND,
+  /* Advertisement message. */
+  UNICAST_MSG_TYPE_ADVERTISEMENT,
+  /* Join message. */
+  UNICAST_MSG_TYPE_JOIN
 };
 
 /**
  * @brief Unicast header.
+ * The route is recorded by collect messages (oldest node first, the oldest
+ * one is dropped when full) and followed by command messages as a source
+ * route (next hop first).
+ * Only the first route_length route addresses are sent (see UNICAST_HDR_SIZE).
  */
 struct unicast_hdr_t {
-  /* Type of message. */
-  enum unicast_msg_type_t type;
+  /* Type of message (see enum unicast_msg_type_t). */
+  uint8_t type;
   /* Hop count. */
   uint8_t hops;
+  /* Number of route addresses. */
+  uint8_t route_length;
+  /* Route addresses. */
+  linkaddr_t route[CONNECTION_ROUTE_MAX_SIZE];
 } __attribute__((packed));
 
 /**
- * @brief Collect message.
+ * @brief Size in byte of a unicast header with route_length route addresses.
  */
-struct collect_msg_t {
-  /* Event sequence number. */
-  uint16_t event_seqn;
-  /* Address of the sensor that generated the event. */
-  linkaddr_t event_source;
-  /* Address of sender sensor node. */
-  linkaddr_t sender;
+#define UNICAST_HDR_SIZE(route_length)     \
+  (offsetof(struct unicast_hdr_t, route) + \
+   (route_length) * sizeof(linkaddr_t))
+
+/**
+ * @brief Collect reading of a sensor node.
+ */
+struct collect_reading_t {
+  /* Slot of sender sensor node. */
+  uint8_t sender;
   /* Node value. */
   uint32_t value;
   /* Node threshold. */
   uint32_t threshold;
+  /* Hop count from the sender node to the node that aggregated it. */
+  uint8_t hops;
+} __attribute__((packed));
+
+/**
+ * @brief Collect message.
+ * Readings of the same event aggregated along the path to the Controller node.
+ * A Sensor node whose reading is unchanged since the last acknowledged one
+ * only sets its bit in the unchanged bitmap.
+ * Only the first num_readings readings are sent, varint encoded (see
+ * codec_collect_pack).
+ */
+struct collect_msg_t {
+  /* Event sequence number. */
+  uint16_t event_seqn;
+  /* Slot of the sensor that generated the event. */
+  uint8_t event_source;
+  /* Bitmap of the Sensor nodes with an unchanged reading. */
+  uint8_t unchanged[CONNECTION_SUBTREE_SIZE];
+  /* Number of readings. */
+  uint8_t num_readings;
+  /* Readings. */
+  struct collect_reading_t readings[ETC_COLLECT_AGGREGATION_MAX_SIZE];
 } __attribute__((packed));
 
 /**
  * @brief Command message.
+ * Sent with a 1 byte command and a varint encoded threshold (see
+ * codec_command_pack).
  */
 struct command_msg_t {
   /* Event sequence number. */
   uint16_t event_seqn;
-  /* Address of the sensor that generated the event. */
-  linkaddr_t event_source;
-  /* Adress of receiver actuator node. */
-  linkaddr_t receiver;
+  /* Slot of the sensor that generated the event. */
+  uint8_t event_source;
+  /* Slot of receiver actuator node. */
+  uint8_t receiver;
   /* Command type. */
   enum command_type_t command;
   /* New threshold. */
   uint32_t threshold;
 } __attribute__((packed));
 
+/**
+ * @brief Collect request message.
+ * Flooded by the Controller node when an event is detected: only the Sensor
+ * nodes in the bitmap send their collect message.
+ */
+struct collect_request_msg_t {
+  /* Event sequence number. */
+  uint16_t event_seqn;
+  /* Slot of the sensor that generated the event. */
+  uint8_t event_source;
+  /* Bitmap of the Sensor nodes that must reply. */
+  uint8_t sensors[CONNECTION_SUBTREE_SIZE];
+} __attribute__((packed));
+
+/**
+ * @brief Command of a Sensor node bundled in the round end message.
+ */
+struct command_entry_t {
+  /* Slot of receiver actuator node. */
+  uint8_t receiver;
+  /* Command type (see enum command_type_t). */
+  uint8_t command;
+  /* New threshold. */
+  uint32_t threshold;
+} __attribute__((packed));
+
+/**
+ * @brief Round end message.
+ * Flooded by the Controller node once the round of an event is complete, with
+ * the commands of the round: each Sensor node extracts its own.
+ * Only the first num_commands commands are sent, varint encoded (see
+ * codec_round_end_pack).
+ */
+struct round_end_msg_t {
+  /* Event sequence number. */
+  uint16_t event_seqn;
+  /* Slot of the sensor that generated the event. */
+  uint8_t event_source;
+  /* Bitmap of the Sensor nodes whose reading has been received (ack). */
+  uint8_t collected[CONNECTION_SUBTREE_SIZE];
+  /* Number of commands. */
+  uint8_t num_commands;
+  /* Commands. */
+  struct command_entry_t commands[ETC_COMMAND_BUNDLE_MAX_SIZE];
+} __attribute__((packed));
+
+/**
+ * @brief Join message.
+ * Sent by a Sensor node to the Controller node to be assigned a slot.
+ */
+struct join_msg_t {
+  /* Sensor address. */
+  linkaddr_t sensor;
+} __attribute__((packed));
+
+/**
+ * @brief Advertisement message.
+ * Subtree bitmap (one bit per Sensor node slot) followed by the hop distance
+ * of each Sensor node in the subtree, in slot order.
+ * Only the distances of the Sensor nodes in the subtree are sent (see
+ * ADVERTISEMENT_MSG_SIZE).
+ */
+struct advertisement_msg_t {
+  /* Subtree bitmap. */
+  uint8_t subtree[CONNECTION_SUBTREE_SIZE];
+  /* Hop distances. */
+  uint8_t distances[MAX_SENSORS];
+} __attribute__((packed));
+
+/**
+ * @brief Size in byte of an advertisement message with num_distances
+ * distances.
+ */
+#define ADVERTISEMENT_MSG_SIZE(num_distances) \
+  (offsetof(struct advertisement_msg_t, distances) + (num_distances))
+
 /* --- CALLBACKS --- */
 /**
  * @brief Connection callbacks.
@@ -228,13 +415,23 @@ bool connection_broadcast_send(enum broadcast_msg_type_t type);
  * @brief Send a unicast message to receiver.
  * A header is added.
  * If no routing final_receiver should be NULL.
+ * The message is dropped if not sent before the deadline.
  *
  * @param header Header.
  * @param receiver Receiver address.
+ * @param deadline Absolute deadline.
  * @return true Message sent.
  * @return false Message not sent due to an error.
  */
 bool connection_unicast_send(const struct unicast_hdr_t *uc_header,
-                             const linkaddr_t *receiver);
+                             const linkaddr_t *receiver, clock_time_t deadline);
+
+/**
+ * @brief Purge buffered collect messages of the event.
+ *
+ * @param event_seqn Event sequence number.
+ * @param event_source Slot of the sensor that generated the event.
+ */
+void connection_unicast_purge(uint16_t event_seqn, uint8_t event_source);
 
 #endif
@@ -1,15 +1,29 @@
 #include "forward.h"
 
+#include "connection/registry.h"
+
 /**
  * @brief Forwardings structure.
+ * Indexed by Sensor node slot.
  */
-static struct forward_t forwardings[NUM_SENSORS];
+static struct forward_t forwardings[MAX_SENSORS];
+
+/* Per sensor table within its share of the memory budget */
+_Static_assert(sizeof(forwardings) <= MAX_SENSORS * SENSORS_MEMORY_FORWARD,
+               "SENSORS_MEMORY_FORWARD too small");
 
 /**
  * @brief Reset forwardings structure.
  */
 static void reset(void);
 
+/**
+ * @brief Reset forward entry.
+ *
+ * @param f Forward entry.
+ */
+static void reset_entry(struct forward_t* f);
+
 /**
  * @brief Shift left hops of a sensor.
  *
@@ -22,8 +36,9 @@ static void shift_left(struct forward_t* f, size_t from);
  * @brief Shift right hops of sensor.
  *
  * @param f Forward entry.
+ * @param from From index to shift.
  */
-static void shift_right(struct forward_t* f);
+static void shift_right(struct forward_t* f, size_t from);
 
 /**
  * @brief Print forwarindgs structure.
@@ -35,17 +50,12 @@ void forward_init(void) { reset(); }
 
 void forward_terminate(void) { reset(); }
 
-struct forward_t* forward_find(const linkaddr_t* sensor) {
-  size_t i;
-
-  for (i = 0; i < NUM_SENSORS; ++i) {
-    if (linkaddr_cmp(sensor, &forwardings[i].sensor)) return &forwardings[i];
-  }
-
-  return NULL;
+struct forward_t* forward_find(uint8_t sensor) {
+  if (sensor >= MAX_SENSORS) return NULL;
+  return &forwardings[sensor];
 }
 
-void forward_add(const linkaddr_t* sensor, const linkaddr_t* hop_address,
+void forward_add(uint8_t sensor, const linkaddr_t* hop_address,
                  uint8_t hop_distance) {
   struct forward_t* f = forward_find(sensor);
   size_t i;
@@ -59,23 +69,29 @@ void forward_add(const linkaddr_t* sensor, const linkaddr_t* hop_address,
     }
   }
 
+  /* Insert by distance (newest first among same distance) */
+  for (i = 0; i < CONNECTION_FORWARD_MAX_SIZE; ++i) {
+    if (f->hops[i].distance >= hop_distance) break;
+  }
+  if (i >= CONNECTION_FORWARD_MAX_SIZE) return; /* Farther than all */
+
   /* Add */
-  shift_right(f);
-  linkaddr_copy(&f->hops[0].address, hop_address);
-  f->hops[0].distance = hop_distance;
+  shift_right(f, i);
+  linkaddr_copy(&f->hops[i].address, hop_address);
+  f->hops[i].distance = hop_distance;
 
   /* Print */
   print_forwardings();
 }
 
-void forward_remove(const linkaddr_t* sensor) {
+void forward_remove(uint8_t sensor) {
   struct forward_t* f = forward_find(sensor);
 
   if (f == NULL) return;
 
-  LOG_WARN("Removing hop %02x:%02x with distance %u for sensor %02x:%02x",
+  LOG_WARN("Removing hop %02x:%02x with distance %u for sensor %u",
            f->hops[0].address.u8[0], f->hops[0].address.u8[1],
-           f->hops[0].distance, sensor->u8[0], sensor->u8[1]);
+           f->hops[0].distance, sensor);
 
   /* Remove */
   shift_left(f, 0);
@@ -84,7 +100,7 @@ void forward_remove(const linkaddr_t* sensor) {
   print_forwardings();
 }
 
-void forward_remove_hop(const linkaddr_t* sensor,
+void forward_remove_hop(uint8_t sensor,
                         const linkaddr_t* hop_address) {
   struct forward_t* f = forward_find(sensor);
   size_t i;
@@ -96,9 +112,9 @@ void forward_remove_hop(const linkaddr_t* sensor,
   }
   if (i >= CONNECTION_FORWARD_MAX_SIZE) return;
 
-  LOG_WARN("Removing hop %02x:%02x at %d with distance %u for sensor %02x:%02x",
+  LOG_WARN("Removing hop %02x:%02x at %d with distance %u for sensor %u",
            f->hops[0].address.u8[0], f->hops[0].address.u8[1], i,
-           f->hops[0].distance, sensor->u8[0], sensor->u8[1]);
+           f->hops[0].distance, sensor);
 
   /* Remove */
   shift_left(f, i);
@@ -107,7 +123,7 @@ void forward_remove_hop(const linkaddr_t* sensor,
   print_forwardings();
 }
 
-size_t forward_hops_length(const linkaddr_t* sensor) {
+size_t forward_hops_length(uint8_t sensor) {
   struct forward_t* f = forward_find(sensor);
   size_t i;
   size_t length = 0;
@@ -122,7 +138,43 @@ size_t forward_hops_length(const linkaddr_t* sensor) {
   return length;
 }
 
-void forward_sort(const linkaddr_t* sensor) {
+void forward_set_route(uint8_t sensor, const linkaddr_t* route,
+                       uint8_t route_length) {
+  struct forward_t* f = forward_find(sensor);
+  const linkaddr_t* address = registry_get(sensor);
+  size_t i;
+
+  if (f == NULL || route_length == 0 ||
+      route_length > CONNECTION_ROUTE_MAX_SIZE)
+    return;
+
+  /* Route of another sensor (aggregated reading) or truncated: the first
+   * node could have no rule for the sensor */
+  if (!linkaddr_cmp(&route[0], address)) return;
+
+  /* Save */
+  for (i = 0; i < route_length; ++i) linkaddr_copy(&f->route[i], &route[i]);
+  f->route_length = route_length;
+
+  /* Print */
+  print_forwardings();
+}
+
+void forward_clear_route(uint8_t sensor) {
+  struct forward_t* f = forward_find(sensor);
+
+  if (f == NULL || f->route_length == 0) return;
+
+  LOG_WARN("Removing route of length %u for sensor %u", f->route_length,
+           sensor);
+
+  f->route_length = 0;
+
+  /* Print */
+  print_forwardings();
+}
+
+void forward_sort(uint8_t sensor) {
   struct forward_t* f = forward_find(sensor);
   struct forward_hop_t tmp;
   size_t i;
@@ -152,29 +204,34 @@ void forward_sort(const linkaddr_t* sensor) {
 /* --- RESET --- */
 static void reset(void) {
   size_t i;
-  size_t j;
 
-  for (i = 0; i < NUM_SENSORS; ++i) {
-    linkaddr_copy(&forwardings[i].sensor, &SENSORS[i]);
-    for (j = 0; j < CONNECTION_FORWARD_MAX_SIZE; ++j) {
-      linkaddr_copy(&forwardings[i].hops[j].address, &linkaddr_null);
-      forwardings[i].hops[j].distance = UINT8_MAX;
-    }
+  for (i = 0; i < MAX_SENSORS; ++i) {
+    reset_entry(&forwardings[i]);
   }
 }
 
-static void shift_right(struct forward_t* f) {
+static void reset_entry(struct forward_t* f) {
+  size_t i;
+
+  for (i = 0; i < CONNECTION_FORWARD_MAX_SIZE; ++i) {
+    linkaddr_copy(&f->hops[i].address, &linkaddr_null);
+    f->hops[i].distance = UINT8_MAX;
+  }
+  f->route_length = 0;
+}
+
+static void shift_right(struct forward_t* f, size_t from) {
   size_t i;
 
   if (f == NULL) return;
 
-  for (i = CONNECTION_FORWARD_MAX_SIZE - 1; i > 0; --i) {
+  for (i = CONNECTION_FORWARD_MAX_SIZE - 1; i > from; --i) {
     linkaddr_copy(&f->hops[i].address, &f->hops[i - 1].address);
     f->hops[i].distance = f->hops[i - 1].distance;
   }
 
-  linkaddr_copy(&f->hops[0].address, &linkaddr_null);
-  f->hops[0].distance = UINT8_MAX;
+  linkaddr_copy(&f->hops[from].address, &linkaddr_null);
+  f->hops[from].distance = UINT8_MAX;
 }
 
 static void shift_left(struct forward_t* f, size_t from) {
@@ -199,14 +256,21 @@ static void print_forwardings(void) {
   logger_set_newline(false);
   LOG_DEBUG("Forwardings: ");
   printf("[ ");
-  for (i = 0; i < NUM_SENSORS; ++i) {
+  for (i = 0; i < MAX_SENSORS; ++i) {
     f = &forwardings[i];
-    printf("%u{ node: %02x:%02x, hops: [ ", i, f->sensor.u8[0],
-           f->sensor.u8[1]);
+    if (linkaddr_cmp(&f->hops[0].address, &linkaddr_null) &&
+        f->route_length == 0)
+      continue;
+    printf("%u{ node: %02x:%02x, hops: [ ", i, registry_get(i)->u8[0],
+           registry_get(i)->u8[1]);
     for (j = 0; j < CONNECTION_FORWARD_MAX_SIZE; ++j) {
       printf("{ address: %02x:%02x, distance: %u } ", f->hops[j].address.u8[0],
              f->hops[j].address.u8[1], f->hops[j].distance);
     }
+    printf("], route: [ ");
+    for (j = 0; j < f->route_length; ++j) {
+      printf("%02x:%02x ", f->route[j].u8[0], f->route[j].u8[1]);
+    }
     printf("] } ");
   }
 }
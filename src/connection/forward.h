@@ -21,10 +21,12 @@ struct forward_hop_t {
  * Note that there could be no forwarding rule available.
  */
 struct forward_t {
-  /* Sensor node address (receiver). */
-  linkaddr_t sensor;
   /* Forwarding nodes (next-hop). */
   struct forward_hop_t hops[CONNECTION_FORWARD_MAX_SIZE];
+  /* Number of route addresses (0 if no route). */
+  uint8_t route_length;
+  /* Route recorded by a collect message (path node first, sensor side). */
+  linkaddr_t route[CONNECTION_ROUTE_MAX_SIZE];
 };
 
 /**
@@ -38,52 +40,74 @@ void forward_init(void);
 void forward_terminate(void);
 
 /**
- * @brief Find a forward entry by sensor address.
+ * @brief Find a forward entry by sensor slot.
  *
- * @param sensor Sensor address.
- * @return Forward entry.
+ * @param sensor Sensor slot.
+ * @return Forward entry or NULL if not a valid slot.
  */
-struct forward_t* forward_find(const linkaddr_t* sensor);
+struct forward_t* forward_find(uint8_t sensor);
 
 /**
  * @brief Add a next hop to reach sensors.
+ * Hops are kept ordered by distance, a hop farther than all the stored ones
+ * is dropped if the table is full.
  *
- * @param sensor Sensor address.
+ * @param sensor Sensor slot.
  * @param hop_address Hop address.
  * @param hop_distance Hop distance.
  */
-void forward_add(const linkaddr_t* sensor, const linkaddr_t* hop_address,
+void forward_add(uint8_t sensor, const linkaddr_t* hop_address,
                  uint8_t hop_distance);
 
 /**
  * @brief Remove the first available hop of the sensor.
  *
- * @param sensor Sensor address.
+ * @param sensor Sensor slot.
  */
-void forward_remove(const linkaddr_t* sensor);
+void forward_remove(uint8_t sensor);
 
 /**
  * @brief Remove a specific hop of the sensor.
  *
- * @param sensor Sensor address.
+ * @param sensor Sensor slot.
  * @param hop_address Hop address.
  */
-void forward_remove_hop(const linkaddr_t* sensor,
+void forward_remove_hop(uint8_t sensor,
                         const linkaddr_t* hop_address);
 
 /**
  * @brief Return the number of available hops of the sensor node.
  *
- * @param sensor Sensor address.
+ * @param sensor Sensor slot.
  * @return Number of available hops.
  */
-size_t forward_hops_length(const linkaddr_t* sensor);
+size_t forward_hops_length(uint8_t sensor);
+
+/**
+ * @brief Save the route recorded by a collect message of the sensor.
+ * Only a route starting at the sensor is saved: the route of an aggregated
+ * collect message is recorded by the sender of the first reading, other
+ * readings keep the hop-by-hop forwarding rules.
+ *
+ * @param sensor Sensor slot.
+ * @param route Route addresses (sensor side first).
+ * @param route_length Number of route addresses.
+ */
+void forward_set_route(uint8_t sensor, const linkaddr_t* route,
+                       uint8_t route_length);
+
+/**
+ * @brief Remove the route of the sensor.
+ *
+ * @param sensor Sensor slot.
+ */
+void forward_clear_route(uint8_t sensor);
 
 /**
  * @brief Sort hops by distance in ASC order.
  *
- * @param sensor Sensor address.
+ * @param sensor Sensor slot.
  */
-void forward_sort(const linkaddr_t* sensor);
+void forward_sort(uint8_t sensor);
 
 #endif
@@ -0,0 +1,208 @@
+#include "neighbor.h"
+
+#include <sys/cc.h>
+
+#include "connection/connection.h"
+#include "logger/logger.h"
+
+/**
+ * @brief Neighbors structure.
+ */
+static struct neighbor_t neighbors[CONNECTION_NEIGHBOR_MAX_SIZE];
+
+/**
+ * @brief Reset neighbors structure.
+ */
+static void reset(void);
+
+/**
+ * @brief Reset neighbor entry.
+ *
+ * @param n Neighbor entry.
+ */
+static void reset_entry(struct neighbor_t *n);
+
+/**
+ * @brief Find a neighbor entry by address.
+ *
+ * @param address Neighbor address.
+ * @return Neighbor entry or NULL if not found.
+ */
+static struct neighbor_t *find(const linkaddr_t *address);
+
+/**
+ * @brief Exponentially weighted moving average.
+ *
+ * @param average Current average.
+ * @param sample New sample.
+ * @return New average.
+ */
+static int32_t ewma(int32_t average, int32_t sample);
+
+/**
+ * @brief Print neighbors structure.
+ */
+static void print_neighbors(void);
+
+/* --- --- */
+void neighbor_init(void) { reset(); }
+
+void neighbor_terminate(void) { reset(); }
+
+const struct neighbor_t *neighbor_get(size_t index) {
+  if (index >= CONNECTION_NEIGHBOR_MAX_SIZE) return NULL;
+  if (linkaddr_cmp(&neighbors[index].address, &linkaddr_null)) return NULL;
+  return &neighbors[index];
+}
+
+size_t neighbor_length(void) {
+  size_t i;
+  size_t length = 0;
+
+  for (i = 0; i < CONNECTION_NEIGHBOR_MAX_SIZE; ++i) {
+    if (!linkaddr_cmp(&neighbors[i].address, &linkaddr_null)) length += 1;
+  }
+
+  return length;
+}
+
+const struct neighbor_t *neighbor_find(const linkaddr_t *address) {
+  /* Free entries have null address */
+  if (linkaddr_cmp(address, &linkaddr_null)) return NULL;
+  return find(address);
+}
+
+bool neighbor_update_beacon(const linkaddr_t *address, uint16_t hopn,
+                            uint16_t path_etx, int16_t rssi) {
+  struct neighbor_t *n = find(address);
+  size_t i;
+
+  if (n == NULL) {
+    /* Find free entry */
+    n = find(&linkaddr_null);
+  }
+
+  if (n == NULL) {
+    /* Table full: find worst neighbor that is not the current parent */
+    for (i = 0; i < CONNECTION_NEIGHBOR_MAX_SIZE; ++i) {
+      if (linkaddr_cmp(&neighbors[i].address,
+                       &connection_get_conn()->parent_node))
+        continue;
+      if (n == NULL || neighbor_path_etx(&neighbors[i]) > neighbor_path_etx(n))
+        n = &neighbors[i];
+    }
+
+    /* Replace only if better */
+    if (n == NULL || (uint32_t)path_etx + CONNECTION_ETX_INITIAL >=
+                         neighbor_path_etx(n)) {
+      LOG_DEBUG("Neighbor table full, ignoring %02x:%02x", address->u8[0],
+                address->u8[1]);
+      return false;
+    }
+
+    LOG_DEBUG("Replacing neighbor %02x:%02x with %02x:%02x", n->address.u8[0],
+              n->address.u8[1], address->u8[0], address->u8[1]);
+  }
+
+  if (!linkaddr_cmp(&n->address, address)) {
+    /* New entry */
+    linkaddr_copy(&n->address, address);
+    n->etx = CONNECTION_ETX_INITIAL;
+    n->rssi = rssi;
+  } else {
+    /* Known entry */
+    n->rssi = ewma(n->rssi, rssi);
+  }
+  n->hopn = hopn;
+  n->path_etx = path_etx;
+
+  print_neighbors();
+
+  return true;
+}
+
+void neighbor_update_tx(const linkaddr_t *address, bool status, int num_tx) {
+  struct neighbor_t *n = find(address);
+  int32_t sample;
+
+  if (n == NULL) return;
+
+  /* ETX sample */
+  sample = (int32_t)MAX(num_tx, 1) * CONNECTION_ETX_SCALE;
+  if (!status) sample += CONNECTION_ETX_FAILURE_PENALTY;
+
+  n->etx = MIN(ewma(n->etx, sample), UINT16_MAX);
+
+  LOG_DEBUG("Neighbor %02x:%02x link ETX %u (%s on %d tx)", address->u8[0],
+            address->u8[1], n->etx, status ? "ack" : "no ack", num_tx);
+}
+
+void neighbor_remove(const linkaddr_t *address) {
+  struct neighbor_t *n = find(address);
+
+  if (n == NULL) return;
+
+  LOG_WARN("Removing neighbor %02x:%02x", address->u8[0], address->u8[1]);
+
+  reset_entry(n);
+
+  print_neighbors();
+}
+
+uint16_t neighbor_path_etx(const struct neighbor_t *neighbor) {
+  if (neighbor->path_etx == UINT16_MAX) return UINT16_MAX;
+  return MIN((uint32_t)neighbor->path_etx + neighbor->etx, UINT16_MAX - 1);
+}
+
+/* --- RESET --- */
+static void reset(void) {
+  size_t i;
+  for (i = 0; i < CONNECTION_NEIGHBOR_MAX_SIZE; ++i) {
+    reset_entry(&neighbors[i]);
+  }
+}
+
+static void reset_entry(struct neighbor_t *n) {
+  linkaddr_copy(&n->address, &linkaddr_null);
+  n->hopn = UINT16_MAX;
+  n->path_etx = UINT16_MAX;
+  n->etx = CONNECTION_ETX_INITIAL;
+  n->rssi = CONNECTION_RSSI_THRESHOLD;
+}
+
+static struct neighbor_t *find(const linkaddr_t *address) {
+  size_t i;
+
+  for (i = 0; i < CONNECTION_NEIGHBOR_MAX_SIZE; ++i) {
+    if (linkaddr_cmp(address, &neighbors[i].address)) return &neighbors[i];
+  }
+
+  return NULL;
+}
+
+static int32_t ewma(int32_t average, int32_t sample) {
+  return (average * CONNECTION_EWMA_ALPHA +
+          sample * (100 - CONNECTION_EWMA_ALPHA)) /
+         100;
+}
+
+static void print_neighbors(void) {
+  if (!logger_is_enabled(LOG_LEVEL_DEBUG)) return;
+
+  size_t i;
+  const struct neighbor_t *n;
+
+  logger_set_newline(false);
+  LOG_DEBUG("Neighbors: ");
+  printf("[ ");
+  for (i = 0; i < CONNECTION_NEIGHBOR_MAX_SIZE; ++i) {
+    n = &neighbors[i];
+    if (linkaddr_cmp(&n->address, &linkaddr_null)) continue;
+    printf(
+        "%u{ address: %02x:%02x, hopn: %u, path_etx: %u, etx: %u, rssi: %d } ",
+        i, n->address.u8[0], n->address.u8[1], n->hopn, n->path_etx, n->etx,
+        n->rssi);
+  }
+  printf("]\n");
+  logger_set_newline(true);
+}
@@ -0,0 +1,106 @@
+#ifndef _CONNECTION_NEIGHBOR_H_
+#define _CONNECTION_NEIGHBOR_H_
+
+#include <net/linkaddr.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "config/config.h"
+
+/**
+ * @brief Neighbor table entry.
+ * Link estimation of a neighbor node learned from beacon messages and unicast
+ * transmissions.
+ * Entries do not age: an entry is only removed when it is replaced by a
+ * better neighbor or when the connection through it is invalidated
+ * (neighbor_remove).
+ * Note that an entry with linkaddr_null address is free.
+ */
+struct neighbor_t {
+  /* Neighbor address. */
+  linkaddr_t address;
+  /* Last advertised hop number. */
+  uint16_t hopn;
+  /* Last advertised path ETX to the Controller node. */
+  uint16_t path_etx;
+  /* Link ETX estimate (EWMA). */
+  uint16_t etx;
+  /* Link RSSI estimate (EWMA). */
+  int16_t rssi;
+};
+
+/**
+ * @brief Initialize neighbor table.
+ */
+void neighbor_init(void);
+
+/**
+ * @brief Terminate neighbor table.
+ */
+void neighbor_terminate(void);
+
+/**
+ * @brief Return the neighbor entry at index.
+ *
+ * @param index Entry index in [0, CONNECTION_NEIGHBOR_MAX_SIZE).
+ * @return Neighbor entry or NULL if the entry is free.
+ */
+const struct neighbor_t *neighbor_get(size_t index);
+
+/**
+ * @brief Return the number of known neighbors.
+ *
+ * @return Number of neighbors.
+ */
+size_t neighbor_length(void);
+
+/**
+ * @brief Find a neighbor entry by address.
+ *
+ * @param address Neighbor address.
+ * @return Neighbor entry or NULL if not found.
+ */
+const struct neighbor_t *neighbor_find(const linkaddr_t *address);
+
+/**
+ * @brief Update a neighbor with a received beacon message.
+ * If the neighbor is unknown a new entry is added.
+ * If the table is full the worst neighbor is replaced only if the new one
+ * is better.
+ *
+ * @param address Neighbor address.
+ * @param hopn Advertised hop number.
+ * @param path_etx Advertised path ETX.
+ * @param rssi RSSI of the reception.
+ * @return true Neighbor updated.
+ * @return false Neighbor not stored.
+ */
+bool neighbor_update_beacon(const linkaddr_t *address, uint16_t hopn,
+                            uint16_t path_etx, int16_t rssi);
+
+/**
+ * @brief Update the link ETX of a neighbor with a unicast transmission.
+ * Unknown neighbors are ignored.
+ *
+ * @param address Neighbor address.
+ * @param status True if the message has been acknowledged.
+ * @param num_tx Number of transmission(s).
+ */
+void neighbor_update_tx(const linkaddr_t *address, bool status, int num_tx);
+
+/**
+ * @brief Remove a neighbor.
+ *
+ * @param address Neighbor address.
+ */
+void neighbor_remove(const linkaddr_t *address);
+
+/**
+ * @brief Return the path ETX to the Controller node through a neighbor.
+ *
+ * @param neighbor Neighbor entry.
+ * @return Path ETX (UINT16_MAX if unreachable).
+ */
+uint16_t neighbor_path_etx(const struct neighbor_t *neighbor);
+
+#endif
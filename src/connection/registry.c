@@ -0,0 +1,442 @@
+#include "registry.h"
+
+#include <net/packetbuf.h>
+#include <string.h>
+#include <sys/cc.h>
+
+#include "config/config.h"
+#include "connection/advertisement.h"
+#include "logger/logger.h"
+#include "node/node.h"
+
+/**
+ * @brief Sensor addresses by slot.
+ * Note that a slot with linkaddr_null address is free.
+ */
+static linkaddr_t sensors[MAX_SENSORS];
+
+/**
+ * @brief Address index (open addressing hash table of slots).
+ */
+static uint8_t address_index[CONNECTION_REGISTRY_INDEX_SIZE];
+
+/* Per sensor tables within their share of the memory budget */
+_Static_assert(sizeof(sensors) + sizeof(address_index) <=
+                   MAX_SENSORS * SENSORS_MEMORY_REGISTRY,
+               "SENSORS_MEMORY_REGISTRY too small");
+
+/**
+ * @brief Number of registered Sensor nodes.
+ */
+static size_t length;
+
+/**
+ * @brief Last registry message sequence number.
+ */
+static uint16_t seqn;
+
+/**
+ * @brief Flag if a registry message has been received.
+ */
+static bool seqn_valid;
+
+/**
+ * @brief Registry message to forward.
+ */
+static struct registry_msg_t forward_msg;
+
+/**
+ * @brief Registry message to forward size in byte.
+ */
+static size_t forward_msg_size;
+
+/**
+ * @brief Next slot to refresh (Controller node).
+ */
+static uint8_t refresh_slot;
+
+/**
+ * @brief Join timer (Sensor node).
+ */
+static struct ctimer join_timer;
+
+/**
+ * @brief Refresh timer (Controller node).
+ */
+static struct ctimer refresh_timer;
+
+/**
+ * @brief Timer to wait before forwarding a registry message.
+ */
+static struct ctimer forward_timer;
+
+/**
+ * @brief Reset registry.
+ */
+static void reset(void);
+
+/**
+ * @brief Hash of an address.
+ *
+ * @param address Address.
+ * @return Hash in [0, CONNECTION_REGISTRY_INDEX_SIZE).
+ */
+static size_t hash(const linkaddr_t *address);
+
+/**
+ * @brief Rebuild the address index.
+ */
+static void rebuild_index(void);
+
+/**
+ * @brief Save the address of a slot.
+ *
+ * @param slot Slot.
+ * @param address Sensor address.
+ */
+static void set(uint8_t slot, const linkaddr_t *address);
+
+/**
+ * @brief Register a Sensor node (Controller node).
+ *
+ * @param address Sensor address.
+ * @return Slot or REGISTRY_SLOT_NONE if full.
+ */
+static uint8_t add(const linkaddr_t *address);
+
+/**
+ * @brief Flood the registry chunk starting at slot (Controller node).
+ *
+ * @param first_slot First slot.
+ */
+static void flood(uint8_t first_slot);
+
+/**
+ * @brief Join timer callback.
+ *
+ * @param ignored
+ */
+static void join_timer_cb(void *ignored);
+
+/**
+ * @brief Refresh timer callback.
+ *
+ * @param ignored
+ */
+static void refresh_timer_cb(void *ignored);
+
+/**
+ * @brief Forward timer callback.
+ *
+ * @param ignored
+ */
+static void forward_timer_cb(void *ignored);
+
+/* --- --- */
+void registry_init(void) {
+  reset();
+
+  switch (node_get_role()) {
+    case NODE_ROLE_CONTROLLER: {
+      ctimer_set(&refresh_timer, CONNECTION_REGISTRY_REFRESH_INTERVAL,
+                 refresh_timer_cb, NULL);
+      break;
+    }
+    case NODE_ROLE_SENSOR_ACTUATOR: {
+      ctimer_set(&join_timer, CONNECTION_REGISTRY_JOIN_INTERVAL, join_timer_cb,
+                 NULL);
+      break;
+    }
+    default: {
+      /* Only learn */
+      break;
+    }
+  }
+}
+
+void registry_terminate(void) {
+  reset();
+  ctimer_stop(&join_timer);
+  ctimer_stop(&refresh_timer);
+  ctimer_stop(&forward_timer);
+}
+
+uint8_t registry_find(const linkaddr_t *address) {
+  size_t i = hash(address);
+  size_t probes;
+
+  for (probes = 0; probes < CONNECTION_REGISTRY_INDEX_SIZE; ++probes) {
+    if (address_index[i] == REGISTRY_SLOT_NONE) break;
+    if (linkaddr_cmp(&sensors[address_index[i]], address))
+      return address_index[i];
+    i = (i + 1) % CONNECTION_REGISTRY_INDEX_SIZE;
+  }
+
+  return REGISTRY_SLOT_NONE;
+}
+
+const linkaddr_t *registry_get(uint8_t slot) {
+  if (slot >= MAX_SENSORS) return &linkaddr_null;
+  return &sensors[slot];
+}
+
+size_t registry_length(void) { return length; }
+
+void registry_recv_cb(const struct broadcast_hdr_t *header,
+                      const linkaddr_t *sender) {
+  struct registry_msg_t msg;
+  size_t i;
+
+  /* Check received registry message validity */
+  if (packetbuf_datalen() < REGISTRY_MSG_SIZE(0) ||
+      packetbuf_datalen() > sizeof(msg)) {
+    LOG_ERROR("Received registry message wrong size: %u byte",
+              packetbuf_datalen());
+    return;
+  }
+
+  /* Copy registry message */
+  packetbuf_copyto(&msg);
+
+  /* Check addresses */
+  if (msg.num_sensors > CONNECTION_REGISTRY_CHUNK_SIZE ||
+      (size_t)msg.first_slot + msg.num_sensors > MAX_SENSORS ||
+      packetbuf_datalen() != REGISTRY_MSG_SIZE(msg.num_sensors)) {
+    LOG_ERROR("Received registry message wrong chunk: %u+%u in %u byte",
+              msg.first_slot, msg.num_sensors, packetbuf_datalen());
+    return;
+  }
+
+  /* Controller is the source */
+  if (node_get_role() == NODE_ROLE_CONTROLLER) return;
+
+  /* Ignore if old (keep in mind seqn overflow) */
+  if (seqn_valid && (int16_t)(msg.seqn - seqn) <= 0) return;
+
+  LOG_INFO(
+      "Received registry message from %02x:%02x: "
+      "{ seqn: %u, first_slot: %u, num_sensors: %u }",
+      sender->u8[0], sender->u8[1], msg.seqn, msg.first_slot, msg.num_sensors);
+
+  seqn = msg.seqn;
+  seqn_valid = true;
+
+  /* Learn */
+  for (i = 0; i < msg.num_sensors; ++i)
+    set(msg.first_slot + i, &msg.sensors[i]);
+
+  /* Registered */
+  if (node_get_role() == NODE_ROLE_SENSOR_ACTUATOR &&
+      registry_find(&linkaddr_node_addr) != REGISTRY_SLOT_NONE &&
+      !ctimer_expired(&join_timer)) {
+    LOG_INFO("Registered in slot %u", registry_find(&linkaddr_node_addr));
+    ctimer_stop(&join_timer);
+  }
+
+  /* Schedule forward */
+  memcpy(&forward_msg, &msg, packetbuf_datalen());
+  forward_msg_size = packetbuf_datalen();
+  ctimer_set(&forward_timer, CONNECTION_REGISTRY_FORWARD_DELAY,
+             forward_timer_cb, NULL);
+}
+
+void registry_join_recv_cb(const struct unicast_hdr_t *header,
+                           const linkaddr_t *sender) {
+  struct join_msg_t join_msg;
+  uint8_t slot;
+
+  /* Check received join message validity */
+  if (packetbuf_datalen() != sizeof(join_msg)) {
+    LOG_ERROR("Received join message wrong size: %u byte",
+              packetbuf_datalen());
+    return;
+  }
+
+  /* Copy join message */
+  packetbuf_copyto(&join_msg);
+
+  LOG_INFO("Received join message from %02x:%02x: { sensor: %02x:%02x }",
+           sender->u8[0], sender->u8[1], join_msg.sensor.u8[0],
+           join_msg.sensor.u8[1]);
+
+  if (node_get_role() != NODE_ROLE_CONTROLLER) {
+    /* Forward join message to parent node */
+    if (!connection_is_connected()) {
+      LOG_WARN(
+          "Unable to forward join message because the node is "
+          "disconnected");
+      return;
+    }
+    connection_unicast_send(header, &connection_get_conn()->parent_node,
+                            clock_time() + CONNECTION_REGISTRY_JOIN_DEADLINE);
+    return;
+  }
+
+  /* Register */
+  slot = add(&join_msg.sensor);
+  if (slot == REGISTRY_SLOT_NONE) {
+    LOG_ERROR("Unable to register sensor %02x:%02x: registry is full",
+              join_msg.sensor.u8[0], join_msg.sensor.u8[1]);
+    return;
+  }
+
+  /* Notify (even if already registered, it has missed the registration) */
+  flood(slot);
+}
+
+/* --- RESET --- */
+static void reset(void) {
+  size_t i;
+
+  for (i = 0; i < MAX_SENSORS; ++i) {
+    linkaddr_copy(&sensors[i], &linkaddr_null);
+  }
+  length = 0;
+  rebuild_index();
+  seqn = 0;
+  seqn_valid = false;
+  forward_msg_size = 0;
+  refresh_slot = 0;
+}
+
+/* --- INDEX --- */
+static size_t hash(const linkaddr_t *address) {
+  return (((size_t)address->u8[0] << 8) | address->u8[1]) %
+         CONNECTION_REGISTRY_INDEX_SIZE;
+}
+
+static void rebuild_index(void) {
+  size_t slot;
+  size_t i;
+
+  memset(address_index, REGISTRY_SLOT_NONE, sizeof(address_index));
+
+  for (slot = 0; slot < MAX_SENSORS; ++slot) {
+    if (linkaddr_cmp(&sensors[slot], &linkaddr_null)) continue;
+    for (i = hash(&sensors[slot]); address_index[i] != REGISTRY_SLOT_NONE;
+         i = (i + 1) % CONNECTION_REGISTRY_INDEX_SIZE)
+      ;
+    address_index[i] = slot;
+  }
+}
+
+static void set(uint8_t slot, const linkaddr_t *address) {
+  uint8_t old_slot;
+
+  if (slot >= MAX_SENSORS || linkaddr_cmp(&sensors[slot], address)) return;
+
+  /* Address moved to another slot */
+  old_slot = registry_find(address);
+  if (old_slot != REGISTRY_SLOT_NONE)
+    linkaddr_copy(&sensors[old_slot], &linkaddr_null);
+
+  LOG_INFO("Sensor %02x:%02x in slot %u", address->u8[0], address->u8[1],
+           slot);
+
+  linkaddr_copy(&sensors[slot], address);
+  length = MAX(length, (size_t)slot + 1);
+  rebuild_index();
+
+  /* Own slot: advertise it */
+  if (linkaddr_cmp(address, &linkaddr_node_addr)) advertisement_trigger();
+}
+
+static uint8_t add(const linkaddr_t *address) {
+  uint8_t slot = registry_find(address);
+
+  if (slot != REGISTRY_SLOT_NONE) return slot;
+  if (length >= MAX_SENSORS) return REGISTRY_SLOT_NONE;
+
+  slot = length;
+  set(slot, address);
+  return slot;
+}
+
+/* --- FLOOD --- */
+static void flood(uint8_t first_slot) {
+  struct registry_msg_t msg;
+  size_t i;
+
+  if (first_slot >= length) return;
+
+  /* Prepare registry message */
+  seqn += 1;
+  msg.seqn = seqn;
+  msg.first_slot = first_slot;
+  msg.num_sensors = MIN(length - first_slot, CONNECTION_REGISTRY_CHUNK_SIZE);
+  for (i = 0; i < msg.num_sensors; ++i)
+    linkaddr_copy(&msg.sensors[i], &sensors[first_slot + i]);
+
+  /* Prepare packetbuf */
+  packetbuf_clear();
+  packetbuf_copyfrom(&msg, REGISTRY_MSG_SIZE(msg.num_sensors));
+
+  /* Send registry message in broadcast */
+  if (!connection_broadcast_send(BROADCAST_MSG_TYPE_REGISTRY))
+    LOG_ERROR("Error sending registry message");
+  else
+    LOG_INFO(
+        "Sending registry message: "
+        "{ seqn: %u, first_slot: %u, num_sensors: %u }",
+        msg.seqn, msg.first_slot, msg.num_sensors);
+}
+
+/* --- TIMERS --- */
+static void join_timer_cb(void *ignored) {
+  struct unicast_hdr_t header;
+  struct join_msg_t join_msg;
+
+  /* Registered */
+  if (registry_find(&linkaddr_node_addr) != REGISTRY_SLOT_NONE) return;
+
+  /* Retry */
+  ctimer_set(&join_timer, CONNECTION_REGISTRY_JOIN_INTERVAL, join_timer_cb,
+             NULL);
+
+  /* Check connection */
+  if (!connection_is_connected()) return;
+
+  /* Prepare header */
+  header.type = UNICAST_MSG_TYPE_JOIN;
+  header.hops = 0;
+  header.route_length = 0;
+
+  /* Prepare join message */
+  linkaddr_copy(&join_msg.sensor, &linkaddr_node_addr);
+
+  /* Prepare packetbuf */
+  packetbuf_clear();
+  packetbuf_copyfrom(&join_msg, sizeof(join_msg));
+
+  /* Send join message in unicast to parent node */
+  if (!connection_unicast_send(
+          &header, &connection_get_conn()->parent_node,
+          clock_time() + CONNECTION_REGISTRY_JOIN_DEADLINE))
+    LOG_ERROR("Error sending join message");
+  else
+    LOG_INFO("Sending join message");
+}
+
+static void refresh_timer_cb(void *ignored) {
+  /* Flood next chunk */
+  if (refresh_slot >= length) refresh_slot = 0;
+  flood(refresh_slot);
+  refresh_slot += CONNECTION_REGISTRY_CHUNK_SIZE;
+
+  ctimer_set(&refresh_timer, CONNECTION_REGISTRY_REFRESH_INTERVAL,
+             refresh_timer_cb, NULL);
+}
+
+static void forward_timer_cb(void *ignored) {
+  if (forward_msg_size == 0) return;
+
+  /* Prepare packetbuf */
+  packetbuf_clear();
+  packetbuf_copyfrom(&forward_msg, forward_msg_size);
+
+  /* Send registry message in broadcast */
+  if (!connection_broadcast_send(BROADCAST_MSG_TYPE_REGISTRY))
+    LOG_ERROR("Error forwarding registry message");
+
+  forward_msg_size = 0;
+}
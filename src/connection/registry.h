@@ -0,0 +1,74 @@
+#ifndef _CONNECTION_REGISTRY_H_
+#define _CONNECTION_REGISTRY_H_
+
+#include <net/linkaddr.h>
+#include <sys/types.h>
+
+#include "connection/connection.h"
+
+/**
+ * @brief Slot of a not registered Sensor node.
+ * Also used as the destination slot of messages to the Controller node.
+ */
+#define REGISTRY_SLOT_NONE (UINT8_MAX)
+
+/**
+ * @brief Initialize registry.
+ * A Sensor node starts to join, the Controller node starts to refresh the
+ * registry of the other nodes.
+ */
+void registry_init(void);
+
+/**
+ * @brief Terminate registry.
+ */
+void registry_terminate(void);
+
+/**
+ * @brief Find the slot of a Sensor node.
+ * The slot is the 1 byte identifier of the Sensor node in messages and
+ * tables.
+ * Constant time lookup on the address index.
+ *
+ * @param address Sensor address.
+ * @return Slot or REGISTRY_SLOT_NONE if not registered.
+ */
+uint8_t registry_find(const linkaddr_t *address);
+
+/**
+ * @brief Return the address of the Sensor node in slot.
+ *
+ * @param slot Slot.
+ * @return Sensor address or linkaddr_null if the slot is free.
+ */
+const linkaddr_t *registry_get(uint8_t slot);
+
+/**
+ * @brief Return the number of registered Sensor nodes.
+ * Slots are assigned in order, so registered slots are in [0, length).
+ *
+ * @return Number of registered Sensor nodes.
+ */
+size_t registry_length(void);
+
+/**
+ * @brief Registry message receive callback.
+ *
+ * @param header Broadcast header.
+ * @param sender Address of the sender node.
+ */
+void registry_recv_cb(const struct broadcast_hdr_t *header,
+                      const linkaddr_t *sender);
+
+/**
+ * @brief Join message receive callback.
+ * The Controller node registers the Sensor node, the other nodes forward the
+ * message to their parent node.
+ *
+ * @param header Unicast header.
+ * @param sender Address of the sender node.
+ */
+void registry_join_recv_cb(const struct unicast_hdr_t *header,
+                           const linkaddr_t *sender);
+
+#endif
@@ -1,19 +1,53 @@
 #include "uc_buffer.h"
 
+#include <string.h>
+#include <sys/cc.h>
+
 #include "config/config.h"
+#include "connection/codec.h"
+#include "connection/registry.h"
 #include "logger/logger.h"
 
 /**
  * @brief Buffer.
+ * Entries never move in memory, order is given by the next pointer.
+ * Sorted list instead of a head/tail ring: adding and removing an entry walk
+ * the list (linear in the number of entries), the length is counted so that
+ * it stays constant time.
  */
 static struct uc_buffer_t buffer[CONNECTION_UC_BUFFER_SIZE];
 
 /**
- * @brief Reset the ith entry in the buffer.
- *
- * @param index Index of the entry.
+ * @brief First entry (NULL if empty).
+ */
+static struct uc_buffer_t *head;
+
+/**
+ * @brief Free entries (NULL if full).
+ */
+static struct uc_buffer_t *free_list;
+
+/**
+ * @brief Current entry (NULL if idle).
+ */
+static struct uc_buffer_t *current;
+
+/**
+ * @brief Destination of the last served virtual queue.
  */
-static void reset_idx(size_t index);
+static uint8_t last_destination;
+
+/**
+ * @brief Number of entries in the buffer (counted, not walked).
+ */
+static size_t length;
+
+/**
+ * @brief Size in byte of a bitmap of destinations.
+ * Bit i is the Sensor node in registry slot i, bit MAX_SENSORS is the
+ * Controller node (REGISTRY_SLOT_NONE) and any slot out of range.
+ */
+#define DESTINATIONS_SIZE ((MAX_SENSORS + 1 + 7) / 8)
 
 /**
  * @brief Reset buffer.
@@ -21,14 +55,48 @@ static void reset_idx(size_t index);
 static void reset(void);
 
 /**
- * @brief Shift buffer to left replacing the first element with the one the
- * right.
- * The last entry is resetted.
- * Example:
- * [REMOVE 2 3] -> [2 3 ?]
- * The ? entry is resetted.
+ * @brief Check if entry a must be served before entry b.
+ *
+ * @param a Entry a.
+ * @param b Entry b.
+ * @return true a before b.
+ * @return false b before (or same as) a.
+ */
+static bool earlier(const struct uc_buffer_t *a, const struct uc_buffer_t *b);
+
+/**
+ * @brief Remove expired entries except the current one.
  */
-static void shift_left(void);
+static void purge_expired(void);
+
+/**
+ * @brief Remove the last low priority entry except the current one.
+ *
+ * @return true Entry removed.
+ * @return false No entry removed.
+ */
+static bool evict_low_priority(void);
+
+/**
+ * @brief Add a destination to a bitmap of destinations.
+ *
+ * @param destinations Bitmap (DESTINATIONS_SIZE byte).
+ * @param destination Final destination slot.
+ * @return true Added.
+ * @return false Already in the bitmap.
+ */
+static bool destinations_add(uint8_t *destinations, uint8_t destination);
+
+/**
+ * @brief Check if a destination is in a bitmap of destinations.
+ *
+ * @param destinations Bitmap (DESTINATIONS_SIZE byte).
+ * @param destination Final destination slot.
+ * @return true In the bitmap.
+ * @return false Not in the bitmap.
+ */
+static bool destinations_has(const uint8_t *destinations,
+                             uint8_t destination);
 
 /* --- --- */
 void uc_buffer_init(void) { reset(); }
@@ -36,19 +104,25 @@ void uc_buffer_init(void) { reset(); }
 void uc_buffer_terminate(void) { reset(); }
 
 bool uc_buffer_add(const struct unicast_hdr_t *header,
-                   const linkaddr_t *receiver) {
-  size_t i;
+                   const linkaddr_t *receiver, clock_time_t deadline) {
+  const enum uc_buffer_priority_t priority =
+      header->type == UNICAST_MSG_TYPE_COMMAND ? UC_BUFFER_PRIORITY_HIGH
+                                               : UC_BUFFER_PRIORITY_LOW;
+  struct command_msg_t command_msg;
+  struct uc_buffer_t *entry;
+  struct uc_buffer_t *prev;
 
   /* Discard null receiver */
   if (linkaddr_cmp(receiver, &linkaddr_null)) return false;
 
-  /* Find a (possible) space */
-  for (i = 0; i < CONNECTION_UC_BUFFER_SIZE; ++i) {
-    if (buffer[i].free) break;
-  }
+  /* Make space if full */
+  if (length >= CONNECTION_UC_BUFFER_SIZE) purge_expired();
+  if (length >= CONNECTION_UC_BUFFER_SIZE &&
+      priority == UC_BUFFER_PRIORITY_HIGH)
+    evict_low_priority();
 
   /* Check buffer availability */
-  if (i >= CONNECTION_UC_BUFFER_SIZE) {
+  if (length >= CONNECTION_UC_BUFFER_SIZE) {
     LOG_ERROR(
         "Unable to save unicast message in buffer: "
         "{ type %d, receiver: %02x:%02x }",
@@ -56,72 +130,224 @@ bool uc_buffer_add(const struct unicast_hdr_t *header,
     return false;
   }
 
+  /* Free entry */
+  entry = free_list;
+  free_list = entry->next;
+
   /* Save */
-  buffer[i].free = false;
+  entry->free = false;
+  entry->next = NULL;
+  entry->priority = priority;
+  entry->deadline = deadline;
+  entry->discovering = false;
   /* Header */
-  buffer[i].header.type = header->type;
-  buffer[i].header.hops = header->hops;
-  /* END Header */
-  linkaddr_copy(&buffer[i].receiver, receiver);
-  buffer[i].receiver_is_parent =
+  memcpy(&entry->header, header, UNICAST_HDR_SIZE(header->route_length));
+  linkaddr_copy(&entry->receiver, receiver);
+  entry->receiver_is_parent =
       linkaddr_cmp(receiver, &connection_get_conn()->parent_node);
-  packetbuf_copyto(buffer[i].data);
-  buffer[i].data_len = packetbuf_datalen();
-  buffer[i].num_send = 0;
-  buffer[i].last_chance = false;
+  packetbuf_copyto(entry->data);
+  entry->data_len = packetbuf_datalen();
+  entry->num_send = 0;
+  entry->last_chance = false;
+
+  /* Destination */
+  if (header->type == UNICAST_MSG_TYPE_COMMAND &&
+      codec_command_unpack(&command_msg, entry->data, entry->data_len))
+    entry->destination = command_msg.receiver;
+  else
+    entry->destination = REGISTRY_SLOT_NONE;
+
+  /* Insert */
+  if (head == NULL || earlier(entry, head)) {
+    entry->next = head;
+    head = entry;
+  } else {
+    prev = head;
+    while (prev->next != NULL && !earlier(entry, prev->next)) prev = prev->next;
+    entry->next = prev->next;
+    prev->next = entry;
+  }
+
+  length += 1;
 
   return true;
 }
 
-void uc_buffer_remove() { shift_left(); }
+void uc_buffer_remove(struct uc_buffer_t *entry) {
+  struct uc_buffer_t **link = &head;
 
-struct uc_buffer_t *uc_buffer_first(void) {
-  return &buffer[0];
+  if (entry == NULL) return;
+
+  /* Find link to entry */
+  while (*link != NULL && *link != entry) link = &(*link)->next;
+  if (*link == NULL) return;
+
+  /* Unlink */
+  *link = entry->next;
+  if (entry == current) current = NULL;
+  ctimer_stop(&entry->discovery_timer);
+
+  /* Free */
+  entry->free = true;
+  entry->discovering = false;
+  entry->next = free_list;
+  free_list = entry;
+  length -= 1;
 }
 
-size_t uc_buffer_length(void) {
-  size_t i;
-  size_t length = 0;
+struct uc_buffer_t *uc_buffer_next(void) {
+  struct uc_buffer_t *entry;
+  struct uc_buffer_t *after = NULL; /* Smallest after last served */
+  struct uc_buffer_t *first = NULL; /* Smallest */
+  uint8_t discovering[DESTINATIONS_SIZE];
+  uint8_t seen[DESTINATIONS_SIZE];
 
-  for (i = 0; i < CONNECTION_UC_BUFFER_SIZE; ++i) {
-    if (buffer[i].free) break;
-    length += 1;
+  /* Blocked virtual queues: a discovery could be anywhere in the queue */
+  memset(discovering, 0, sizeof(discovering));
+  for (entry = head; entry != NULL; entry = entry->next) {
+    if (entry->discovering) destinations_add(discovering, entry->destination);
   }
 
-  return length;
+  memset(seen, 0, sizeof(seen));
+  for (entry = head; entry != NULL; entry = entry->next) {
+    /* Only first of each virtual queue, not blocked */
+    if (!destinations_add(seen, entry->destination) ||
+        destinations_has(discovering, entry->destination))
+      continue;
+
+    if (entry->destination > last_destination &&
+        (after == NULL || entry->destination < after->destination))
+      after = entry;
+    if (first == NULL || entry->destination < first->destination)
+      first = entry;
+  }
+
+  /* Round-robin */
+  current = after != NULL ? after : first;
+  if (current != NULL) last_destination = current->destination;
+
+  return current;
 }
 
-bool uc_bufffer_is_empty(void) { return buffer[0].free; }
+struct uc_buffer_t *uc_buffer_current(void) { return current; }
 
-/* --- RESET --- */
-static void reset_idx(size_t index) {
-  if (index < 0 || index >= CONNECTION_UC_BUFFER_SIZE) return;
+struct uc_buffer_t *uc_buffer_find_discovering(uint8_t destination) {
+  struct uc_buffer_t *entry;
+
+  for (entry = head; entry != NULL; entry = entry->next) {
+    if (entry->discovering && entry->destination == destination)
+      return entry;
+  }
+
+  return NULL;
+}
+
+size_t uc_buffer_length(void) { return length; }
+
+bool uc_bufffer_is_empty(void) { return length == 0; }
+
+bool uc_buffer_is_expired(const struct uc_buffer_t *entry) {
+  /* Deadline before now (keep in mind clock overflow) */
+  return (clock_time_t)(clock_time() - entry->deadline) <
+         ((clock_time_t)~0 >> 1);
+}
+
+void uc_buffer_purge_event(uint16_t event_seqn, uint8_t event_source) {
+  struct uc_buffer_t *entry = head;
+  struct uc_buffer_t *next;
+  struct collect_msg_t collect_msg;
+
+  while (entry != NULL) {
+    next = entry->next;
 
-  buffer[index].free = true;
+    if (entry->header.type == UNICAST_MSG_TYPE_COLLECT &&
+        codec_collect_unpack(&collect_msg, entry->data, entry->data_len) &&
+        collect_msg.event_seqn == event_seqn &&
+        collect_msg.event_source == event_source) {
+      if (entry == current) {
+        /* Could be in flight: expire */
+        entry->deadline = clock_time();
+      } else {
+        LOG_INFO(
+            "Purging collect message of event { seqn: %u, source: %u }",
+            collect_msg.event_seqn, collect_msg.event_source);
+        uc_buffer_remove(entry);
+      }
+    }
+
+    entry = next;
+  }
 }
 
+/* --- RESET --- */
 static void reset(void) {
   size_t i;
   for (i = 0; i < CONNECTION_UC_BUFFER_SIZE; ++i) {
-    reset_idx(i);
+    ctimer_stop(&buffer[i].discovery_timer);
+    buffer[i].free = true;
+    buffer[i].discovering = false;
+    buffer[i].next = i + 1 < CONNECTION_UC_BUFFER_SIZE ? &buffer[i + 1] : NULL;
   }
+  head = NULL;
+  free_list = &buffer[0];
+  current = NULL;
+  last_destination = 0;
+  length = 0;
 }
 
-static void shift_left(void) {
-  size_t i;
-  for (i = 0; i < CONNECTION_UC_BUFFER_SIZE - 1; ++i) {
-    buffer[i].free = buffer[i + 1].free;
-    /* Header */
-    buffer[i].header.type = buffer[i + 1].header.type;
-    buffer[i].header.hops = buffer[i + 1].header.hops;
-    /* END Header */
-    linkaddr_copy(&buffer[i].receiver, &buffer[i + 1].receiver);
-    buffer[i].receiver_is_parent = buffer[i + 1].receiver_is_parent;
-    memcpy(buffer[i].data, buffer[i + 1].data, buffer[i + 1].data_len);
-    buffer[i].data_len = buffer[i + 1].data_len;
-    buffer[i].num_send = buffer[i + 1].num_send;
-    buffer[i].last_chance = buffer[i + 1].last_chance;
+/* --- ORDER --- */
+static bool earlier(const struct uc_buffer_t *a, const struct uc_buffer_t *b) {
+  const clock_time_t diff = (clock_time_t)(b->deadline - a->deadline);
+
+  if (diff == 0) return a->priority > b->priority;
+  /* a deadline before b deadline (keep in mind clock overflow) */
+  return diff < ((clock_time_t)~0 >> 1);
+}
+
+static void purge_expired(void) {
+  struct uc_buffer_t *entry = head;
+  struct uc_buffer_t *next;
+
+  while (entry != NULL) {
+    next = entry->next;
+    if (entry != current && uc_buffer_is_expired(entry)) {
+      LOG_INFO("Purging expired unicast message: { type: %d }",
+               entry->header.type);
+      uc_buffer_remove(entry);
+    }
+    entry = next;
+  }
+}
+
+static bool evict_low_priority(void) {
+  struct uc_buffer_t *entry;
+  struct uc_buffer_t *last = NULL;
+
+  /* Find last low priority entry */
+  for (entry = head; entry != NULL; entry = entry->next) {
+    if (entry != current && entry->priority == UC_BUFFER_PRIORITY_LOW)
+      last = entry;
   }
+  if (last == NULL) return false;
+
+  LOG_WARN("Evicting unicast message to make space: { type: %d }",
+           last->header.type);
+  uc_buffer_remove(last);
+  return true;
+}
+
+/* --- DESTINATIONS --- */
+static bool destinations_add(uint8_t *destinations, uint8_t destination) {
+  const size_t bit = MIN(destination, MAX_SENSORS);
+
+  if (destinations[bit / 8] & (1 << (bit % 8))) return false;
+  destinations[bit / 8] |= 1 << (bit % 8);
+  return true;
+}
+
+static bool destinations_has(const uint8_t *destinations,
+                             uint8_t destination) {
+  const size_t bit = MIN(destination, MAX_SENSORS);
 
-  reset_idx(i);
+  return destinations[bit / 8] & (1 << (bit % 8));
 }
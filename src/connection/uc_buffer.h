@@ -4,10 +4,23 @@
 #include <net/linkaddr.h>
 #include <net/packetbuf.h>
 #include <stdbool.h>
+#include <sys/clock.h>
+#include <sys/ctimer.h>
 #include <sys/types.h>
 
 #include "connection.h"
 
+/**
+ * @brief Unicast buffer priority classes.
+ * Used to break ties between entries with the same deadline.
+ */
+enum uc_buffer_priority_t {
+  /* Low priority (collect). */
+  UC_BUFFER_PRIORITY_LOW,
+  /* High priority (command). */
+  UC_BUFFER_PRIORITY_HIGH
+};
+
 /**
  * @brief Unicast buffer entry.
  * Cache structure for a unicast message.
@@ -15,6 +28,19 @@
 struct uc_buffer_t {
   /* Free entry flag. */
   bool free;
+  /* Next entry (NULL if last). */
+  struct uc_buffer_t *next;
+  /* Priority class. */
+  enum uc_buffer_priority_t priority;
+  /* Absolute deadline after which the message is useless. */
+  clock_time_t deadline;
+  /* Final destination slot (virtual queue), REGISTRY_SLOT_NONE if the
+   * Controller node. */
+  uint8_t destination;
+  /* Flag if a forward discovery is in progress for the destination. */
+  bool discovering;
+  /* Forward discovery timer. */
+  struct ctimer discovery_timer;
   /* Header. */
   struct unicast_hdr_t header;
   /* Receiver address. */
@@ -43,34 +69,82 @@ void uc_buffer_terminate(void);
 
 /**
  * @brief Add an entry to the unicast buffer.
- * Note that if the buffer is full no entry could be added and false is
+ * Entries are split in virtual queues by final destination: the Controller
+ * node for collect messages, the receiver for command messages.
+ * Within a virtual queue entries are served earliest deadline first, ties are
+ * broken by priority class.
+ * If the buffer is full expired entries are dropped, then a command could
+ * replace the latest collect.
+ * Linear in the number of entries (sorted insert).
+ * Note that if no space is available no entry could be added and false is
  * returned.
  *
  * @param header Header.
  * @param receiver Receiver address.
+ * @param deadline Absolute deadline.
  * @return true Entry added.
  * @return false Entry not added.
  */
 bool uc_buffer_add(const struct unicast_hdr_t *header,
-                   const linkaddr_t *receiver);
+                   const linkaddr_t *receiver, clock_time_t deadline);
 
 /**
- * @brief Remove first entry in the unicast buffer.
- * A call to this function cause a shift in the buffer.
+ * @brief Remove an entry from the unicast buffer.
+ * Remaining entries are not moved in memory.
+ * Linear in the number of entries (the link to the entry is searched).
+ *
+ * @param entry Buffered message.
+ */
+void uc_buffer_remove(struct uc_buffer_t *entry);
+
+/**
+ * @brief Select the next message to send.
+ * Virtual queues are served round-robin, skipping the ones with a forward
+ * discovery in progress.
+ * Linear in the number of entries.
+ * The selected message becomes the current one.
+ *
+ * @return Next buffered message or NULL if none is available.
+ */
+struct uc_buffer_t *uc_buffer_next(void);
+
+/**
+ * @brief Return the current message (selected by uc_buffer_next).
+ *
+ * @return Current buffered message or NULL if idle.
+ */
+struct uc_buffer_t *uc_buffer_current(void);
+
+/**
+ * @brief Find the message with a forward discovery in progress for the
+ * destination.
+ *
+ * @param destination Final destination slot.
+ * @return Buffered message or NULL if not found.
+ */
+struct uc_buffer_t *uc_buffer_find_discovering(uint8_t destination);
+
+/**
+ * @brief Check if the deadline of an entry has passed.
+ *
+ * @param entry Buffered message.
+ * @return true Expired.
+ * @return false Not expired.
  */
-void uc_buffer_remove(void);
+bool uc_buffer_is_expired(const struct uc_buffer_t *entry);
 
 /**
- * @brief Return first message in buffer.
- * Note that the buffered message could be invalid, check free == false to be
- * sure that the entry is valid.
+ * @brief Purge collect messages of the event.
+ * The current entry is not removed (could be in flight) but it is expired.
  *
- * @return First buffered message.
+ * @param event_seqn Event sequence number.
+ * @param event_source Slot of the sensor that generated the event.
  */
-struct uc_buffer_t *uc_buffer_first(void);
+void uc_buffer_purge_event(uint16_t event_seqn, uint8_t event_source);
 
 /**
  * @brief Current number of unicast messages in the buffer.
+ * Constant time.
  *
  * @return Messages in buffer.
  */
@@ -78,6 +152,7 @@ size_t uc_buffer_length(void);
 
 /**
  * @brief Check if unicast buffer is empty.
+ * Constant time.
  *
  * @return true Empty.
  * @return false Not empty.
@@ -2,10 +2,63 @@
 
 #include <net/mac/mac.h>
 #include <net/packetbuf.h>
+#include <string.h>
+#include <sys/cc.h>
 
 #include "config/config.h"
+#include "connection/codec.h"
 #include "connection/connection.h"
 #include "connection/forward.h"
+#include "connection/neighbor.h"
+#include "connection/registry.h"
+
+/**
+ * @brief Event round.
+ * State of an event from its detection to the end of its round.
+ * Note that a round with REGISTRY_SLOT_NONE event source is free.
+ */
+struct round_t {
+  /* Event. */
+  struct etc_event_t event;
+  /* Timer to free the round: round end or safety ceiling. */
+  struct ctimer lifetime_timer;
+  /* Flag if the round is complete. */
+  bool ended;
+  /* Timer to wait before sending the event message. */
+  struct ctimer event_timer;
+  /* Number of copies of the event message overheard while waiting to forward
+   * it. */
+  uint8_t event_copies;
+  /* Readings overheard on event messages. */
+  struct event_reading_t readings[ETC_EVENT_PIGGYBACK_MAX_SIZE];
+  /* Number of readings. */
+  uint8_t num_readings;
+  /* Flag if the own reading has been received by the Controller node. */
+  bool reading_seen;
+  /* Flag if the own reading has been sent. */
+  bool reading_sent;
+  /* Value of the last own reading sent. */
+  uint32_t sent_value;
+  /* Threshold of the last own reading sent. */
+  uint32_t sent_threshold;
+  /* Flag if the own reading has been sent as unchanged. */
+  bool unchanged_sent;
+  /* Flag if the collect request has been received. */
+  bool request_received;
+  /* Bitmap of the Sensor nodes that must reply (valid if received). */
+  uint8_t request[CONNECTION_SUBTREE_SIZE];
+  /* Timer to wait before rebroadcasting the collect request message. */
+  struct ctimer request_timer;
+  /* Timer to wait before sending the collect message. */
+  struct ctimer collect_timer;
+  /* Collect readings waiting to be forwarded in a single collect message. */
+  struct collect_msg_t aggregation;
+  /* Header of the aggregated collect message, keeps the route recorded by the
+   * first aggregated collect message. */
+  struct unicast_hdr_t aggregation_header;
+  /* Timer to wait before forwarding the aggregated collect readings. */
+  struct ctimer aggregation_timer;
+};
 
 /* Sensor value. */
 static uint32_t sensor_value;
@@ -16,40 +69,132 @@ static uint32_t sensor_threshold;
 /* Sensor event seqn */
 static uint32_t sensor_event_seqn;
 
+/**
+ * @brief Last own reading acknowledged by the Controller node.
+ */
+static struct {
+  /* Flag if a reading has been acknowledged. */
+  bool available;
+  /* Value. */
+  uint32_t value;
+  /* Threshold. */
+  uint32_t threshold;
+} acked;
+
 /**
  * @brief ETC callback(s) to interact with the node.
  */
 static const struct etc_callbacks_t *cb;
+
+/**
+ * @brief Event rounds in flight.
+ */
+static struct round_t rounds[ETC_MAX_ROUNDS];
+
+/**
+ * @brief Most recent event.
+ */
+static struct etc_event_t last_event;
+
+/**
+ * @brief Last event sequence number of the sensor in registry slot i.
+ */
+static uint16_t last_seqns[MAX_SENSORS];
+
+/**
+ * @brief Last propagated round end sequence number of the event source in
+ * registry slot i.
+ * Independent of the rounds: a round end message is propagated even if the
+ * event is not in flight, so that bundled commands reach the whole subtree.
+ */
+static uint16_t end_seqns[MAX_SENSORS];
+
+/* Per sensor tables within their share of the memory budget */
+_Static_assert(sizeof(last_seqns) + sizeof(end_seqns) <=
+                   MAX_SENSORS * SENSORS_MEMORY_ETC,
+               "SENSORS_MEMORY_ETC too small");
+
+/**
+ * @brief Round end message waiting to be rebroadcast.
+ */
+struct round_end_relay_t {
+  /* Round end message. */
+  struct round_end_msg_t msg;
+  /* Timer to wait before rebroadcasting the round end message. */
+  struct ctimer timer;
+};
+
+/**
+ * @brief Round end messages waiting to be rebroadcast.
+ */
+static struct round_end_relay_t round_end_relays[ETC_MAX_ROUNDS];
+
+/* --- ROUND --- */
 /**
- * @brief Current event.
+ * @brief Find the round of an event.
+ *
+ * @param event_seqn Event sequence number.
+ * @param event_source Slot of the sensor that generated the event.
+ * @return Round or NULL if not in flight.
  */
-static struct etc_event_t event;
+static struct round_t *round_find(uint16_t event_seqn, uint8_t event_source);
 
 /**
- * @brief Timer to stop the generation of new event(s).
+ * @brief Find the round of an event generated by source.
+ *
+ * @param event_source Slot of the sensor that generated the event.
+ * @return Round or NULL if not in flight.
  */
-static struct ctimer suppression_timer_new;
+static struct round_t *round_find_source(uint8_t event_source);
 
 /**
- * @brief Timer to stop the propagation of event(s).
+ * @brief Start the round of an event in a free round.
+ * A critical event preempts a round that is not critical if there is no free
+ * round.
+ * The round is freed after lifetime at the latest (safety ceiling).
+ *
+ * @param event_seqn Event sequence number.
+ * @param event_source Slot of the sensor that generated the event.
+ * @param priority Event priority.
+ * @param lifetime Maximum lifetime of the round.
+ * @return Round or NULL if ETC_MAX_ROUNDS rounds are in flight.
  */
-static struct ctimer suppression_timer_propagation;
+static struct round_t *round_new(uint16_t event_seqn, uint8_t event_source,
+                                 enum event_priority_t priority,
+                                 clock_time_t lifetime);
 
 /**
- * @brief Timer to wait before stop event(s) propagation timer after a command
- * message is received.
+ * @brief Mark the round as complete.
+ * The round is freed after ETC_SUPPRESSION_EVENT_PROPAGATION_END.
+ *
+ * @param round Round.
  */
-static struct ctimer suppression_timer_propagation_end;
+static void round_end(struct round_t *round);
 
 /**
- * @brief Timer to wait before sending the event message.
+ * @brief Acknowledge the own reading with the collected bitmap of the round
+ * end.
+ * The own reading sent is acknowledged if collected, forgotten otherwise.
+ *
+ * @param round Round.
+ * @param collected Bitmap of the Sensor nodes whose reading has been received.
  */
-static struct ctimer event_timer;
+static void round_collected(struct round_t *round, const uint8_t *collected);
 
 /**
- * @brief Timer to wait before sending the collect message.
+ * @brief Round lifetime timer callback.
+ *
+ * @param ptr Round.
  */
-static struct ctimer collect_timer;
+static void round_lifetime_cb(void *ptr);
+
+/**
+ * @brief Free the round.
+ * Buffered collect message(s) of the event are purged.
+ *
+ * @param round Round.
+ */
+static void round_free(struct round_t *round);
 
 /* --- EVENT MESSAGE--- */
 /**
@@ -64,9 +209,18 @@ static void event_msg_cb(const struct broadcast_hdr_t *header,
 /**
  * @brief Event timer callback.
  *
- * @param ignored
+ * @param ptr Round.
  */
-static void event_timer_cb(void *ignored);
+static void event_timer_cb(void *ptr);
+
+/**
+ * @brief Return the number of overheard copies of an event message after
+ * which its rebroadcast is cancelled.
+ * Adapted to the neighbor density: UINT8_MAX (never) if sparse.
+ *
+ * @return Copies threshold.
+ */
+static uint8_t event_suppression_counter(void);
 
 /**
  * @brief Send event message.
@@ -77,6 +231,21 @@ static void event_timer_cb(void *ignored);
  */
 static bool send_event_message(const struct event_msg_t *event_msg);
 
+/**
+ * @brief Handle the readings piggybacked on an event message of the round.
+ * Readings are saved to be rebroadcast, the Controller node forwards new
+ * readings to the collect callback.
+ * The own reading in the rebroadcast of the Controller node marks the reading
+ * as seen.
+ *
+ * @param round Round.
+ * @param event_msg Event message of the round event.
+ * @param sender Address of the sender node.
+ */
+static void piggyback_recv(struct round_t *round,
+                           const struct event_msg_t *event_msg,
+                           const linkaddr_t *sender);
+
 /* --- COLLECT MESSAGE --- */
 /**
  * @brief Collect message receive callback.
@@ -87,12 +256,94 @@ static bool send_event_message(const struct event_msg_t *event_msg);
 static void collect_msg_cb(const struct unicast_hdr_t *header,
                            const linkaddr_t *sender);
 
+/**
+ * @brief Forward a collect message of an event not in flight to the parent
+ * node, without aggregation.
+ * A relay that missed the event or already ended its round still forwards
+ * the readings the Controller node could be waiting for (e.g. a pull reply).
+ *
+ * @param header Unicast header.
+ * @param collect_msg Collect message (readings hop counts are updated).
+ */
+static void collect_forward(const struct unicast_hdr_t *header,
+                            struct collect_msg_t *collect_msg);
+
 /**
  * @brief Collect timer callback.
  *
- * @param ignored
+ * @param ptr Round.
+ */
+static void collect_timer_cb(void *ptr);
+
+/**
+ * @brief Return the time to wait before sending the collect message.
+ * Collect messages are sent in a wave ordered by depth, deeper nodes first,
+ * so that relays aggregate the readings as the wave passes.
+ * The slot is relative to the time the event has been detected, a random
+ * offset within the slot spreads nodes at the same depth.
+ *
+ * @param round Round.
+ * @return Collect start delay.
+ */
+static clock_time_t collect_start_delay(const struct round_t *round);
+
+/**
+ * @brief Add a collect reading of the round to the aggregation.
+ * A newer reading of the same sender replaces the older one.
+ * The aggregation is forwarded when full or when the aggregation timer
+ * expires.
+ * The route of the first reading is kept.
+ *
+ * @param round Round.
+ * @param header Header of the received collect message (NULL if own).
+ * @param sender Slot of sender sensor node.
+ * @param value Node value.
+ * @param threshold Node threshold.
+ * @param hops Hop count from the sender node.
+ */
+static void aggregation_add(struct round_t *round,
+                            const struct unicast_hdr_t *header, uint8_t sender,
+                            uint32_t value, uint32_t threshold, uint8_t hops);
+
+/**
+ * @brief Add an unchanged reading of the round to the aggregation.
+ *
+ * @param round Round.
+ * @param sender Slot of sender sensor node.
+ */
+static void aggregation_add_unchanged(struct round_t *round, uint8_t sender);
+
+/**
+ * @brief Check if the own reading is unchanged since the last acknowledged
+ * one.
+ * A value above the threshold is never unchanged: the Controller node must
+ * actuate on the actual value.
+ *
+ * @return true Unchanged (within ETC_COLLECT_DELTA).
+ * @return false Changed, above the threshold or never acknowledged.
+ */
+static bool reading_unchanged(void);
+
+/**
+ * @brief Aggregation timer callback.
+ *
+ * @param ptr Round.
+ */
+static void aggregation_timer_cb(void *ptr);
+
+/**
+ * @brief Forward the aggregated collect readings to parent node.
+ *
+ * @param round Round.
  */
-static void collect_timer_cb(void *ignored);
+static void aggregation_flush(struct round_t *round);
+
+/**
+ * @brief Reset the aggregation.
+ *
+ * @param round Round.
+ */
+static void aggregation_reset(struct round_t *round);
 
 /**
  * @brief Send collect message to receiver node.
@@ -101,12 +352,79 @@ static void collect_timer_cb(void *ignored);
  * @param header Header.
  * @param collect_msg Collect message to send.
  * @param receiver Receiver node address.
+ * @param deadline Time within which the message must be delivered.
  * @return true Collect message sent.
  * @return false Collect message not sent due to an error.
  */
 static bool send_collect_message(const struct unicast_hdr_t *header,
                                  const struct collect_msg_t *collect_msg,
-                                 const linkaddr_t *receiver);
+                                 const linkaddr_t *receiver,
+                                 clock_time_t deadline);
+
+/* --- COLLECT REQUEST MESSAGE --- */
+/**
+ * @brief Collect request message receive callback.
+ *
+ * @param header Broadcast header.
+ * @param sender Address of the sender node.
+ */
+static void collect_request_msg_cb(const struct broadcast_hdr_t *header,
+                                   const linkaddr_t *sender);
+
+/**
+ * @brief Collect request timer callback.
+ *
+ * @param ptr Round.
+ */
+static void collect_request_timer_cb(void *ptr);
+
+/**
+ * @brief Send collect request message.
+ *
+ * @param event_seqn Event sequence number.
+ * @param event_source Slot of the sensor that generated the event.
+ * @param sensors Bitmap of the Sensor nodes that must reply.
+ * @return true Collect request message sent.
+ * @return false Collect request message not sent due to an error.
+ */
+static bool send_collect_request_message(uint16_t event_seqn,
+                                         uint8_t event_source,
+                                         const uint8_t *sensors);
+
+/* --- ROUND END MESSAGE --- */
+/**
+ * @brief Round end message receive callback.
+ *
+ * @param header Broadcast header.
+ * @param sender Address of the sender node.
+ */
+static void round_end_msg_cb(const struct broadcast_hdr_t *header,
+                             const linkaddr_t *sender);
+
+/**
+ * @brief Round end timer callback.
+ *
+ * @param ptr Round end relay.
+ */
+static void round_end_timer_cb(void *ptr);
+
+/**
+ * @brief Check if a round end message is new and mark it as propagated.
+ *
+ * @param round_end_msg Round end message.
+ * @return true New: to propagate.
+ * @return false Already propagated or old.
+ */
+static bool round_end_new(const struct round_end_msg_t *round_end_msg);
+
+/**
+ * @brief Send round end message.
+ *
+ * @param round_end_msg Round end message.
+ * @return true Round end message sent.
+ * @return false Round end message not sent due to an error.
+ */
+static bool send_round_end_message(const struct round_end_msg_t *round_end_msg);
 
 /* --- COMMAND MESSAGE--- */
 /**
@@ -119,11 +437,27 @@ static void command_msg_cb(const struct unicast_hdr_t *header,
                            const linkaddr_t *sender);
 
 /**
- * @brief Suppression timer propagation end callback.
+ * @brief Deliver an own command to the command callback.
+ * The commanded reading becomes the acknowledged one, as a whole: if its
+ * value is unknown (THRESHOLD without an own reading sent in the round) there
+ * is no acknowledged reading.
  *
- * @param ignored
+ * @param round Round of the command event (NULL if not in flight).
+ * @param command_msg Command message.
  */
-static void suppression_timer_propagation_end_cb(void *ignored);
+static void command_deliver(struct round_t *round,
+                            const struct command_msg_t *command_msg);
+
+/**
+ * @brief Answer a pull command with the own current reading.
+ * The collect message is sent right away, even if the own reading has
+ * already been sent or the round is not in flight.
+ *
+ * @param round Round of the command event (NULL if not in flight).
+ * @param command_msg Command message.
+ */
+static void pull_reply(struct round_t *round,
+                       const struct command_msg_t *command_msg);
 
 /**
  * @brief Send command message to receiver node.
@@ -175,45 +509,62 @@ static struct connection_callbacks_t conn_cb = {
 
 /* --- --- */
 void etc_open(uint16_t channel, const struct etc_callbacks_t *callbacks) {
+  size_t i;
+
   cb = callbacks;
 
   /* Event */
-  event.seqn = 0;
-  linkaddr_copy(&event.source, &linkaddr_null);
+  last_event.seqn = 0;
+  last_event.source = REGISTRY_SLOT_NONE;
+  last_event.priority = EVENT_PRIORITY_NORMAL;
+  last_event.time = 0;
+  for (i = 0; i < MAX_SENSORS; ++i) {
+    last_seqns[i] = 0;
+    end_seqns[i] = 0;
+  }
+
+  /* Rounds */
+  for (i = 0; i < ETC_MAX_ROUNDS; ++i)
+    rounds[i].event.source = REGISTRY_SLOT_NONE;
 
   /* Sensor */
   sensor_event_seqn = 0;
   sensor_value = 0;
   sensor_threshold = 0;
+  acked.available = false;
 
   /* Open connection */
   connection_open(channel, &conn_cb);
 }
 
 void etc_close(void) {
+  size_t i;
+
   cb = NULL;
 
+  /* Rounds */
+  for (i = 0; i < ETC_MAX_ROUNDS; ++i) {
+    if (rounds[i].event.source != REGISTRY_SLOT_NONE) round_free(&rounds[i]);
+  }
+  for (i = 0; i < ETC_MAX_ROUNDS; ++i) ctimer_stop(&round_end_relays[i].timer);
+
   /* Event */
-  event.seqn = 0;
-  linkaddr_copy(&event.source, &linkaddr_null);
+  last_event.seqn = 0;
+  last_event.source = REGISTRY_SLOT_NONE;
+  last_event.priority = EVENT_PRIORITY_NORMAL;
+  last_event.time = 0;
 
   /* Sensor */
   sensor_event_seqn = 0;
   sensor_value = 0;
   sensor_threshold = 0;
-
-  /* Timers */
-  ctimer_stop(&suppression_timer_new);
-  ctimer_stop(&suppression_timer_propagation);
-  ctimer_stop(&suppression_timer_propagation_end);
-  ctimer_stop(&event_timer);
-  ctimer_stop(&collect_timer);
+  acked.available = false;
 
   /* Close connection */
   connection_close();
 }
 
-const struct etc_event_t *etc_get_current_event(void) { return &event; }
+const struct etc_event_t *etc_get_current_event(void) { return &last_event; }
 
 void etc_update(uint32_t value, uint32_t threshold) {
   /* Update sensor data */
@@ -222,56 +573,80 @@ void etc_update(uint32_t value, uint32_t threshold) {
 }
 
 bool etc_trigger(uint32_t value, uint32_t threshold) {
-  /* Ignore if suppression is active */
-  if (!ctimer_expired(&suppression_timer_new) ||
-      !ctimer_expired(&suppression_timer_propagation))
-    return false;
+  const uint8_t slot = registry_find(&linkaddr_node_addr);
+  const enum event_priority_t priority =
+      value >= threshold && value - threshold >= ETC_EVENT_CRITICAL_MARGIN
+          ? EVENT_PRIORITY_CRITICAL
+          : EVENT_PRIORITY_NORMAL;
+  struct round_t *round;
+
+  /* Ignore if not registered */
+  if (slot == REGISTRY_SLOT_NONE) return false;
+
+  /* Ignore if own event is in flight, unless preempted */
+  round = round_find_source(slot);
+  if (round != NULL) {
+    if (priority <= round->event.priority) return false;
+    LOG_INFO("Critical event preempts own event { seqn: %u }",
+             round->event.seqn);
+    round_free(round);
+  }
+
+  /* Start round (suppressed if too many rounds in flight) */
+  round = round_new(sensor_event_seqn + 1, slot, priority,
+                    ETC_SUPPRESSION_EVENT_NEW);
+  if (round == NULL) return false;
 
   /* Update event */
   sensor_event_seqn += 1;
-  event.seqn = sensor_event_seqn;
-  linkaddr_copy(&event.source, &linkaddr_node_addr);
-
-  /* Start to suppress new event(s) */
-  ctimer_set(&suppression_timer_new, ETC_SUPPRESSION_EVENT_NEW, NULL, NULL);
-
-  /* Start to suppress event propagation */
-  ctimer_set(&suppression_timer_propagation, ETC_SUPPRESSION_EVENT_PROPAGATION,
-             NULL, NULL);
+  last_seqns[slot] = round->event.seqn;
 
   /* Schedule collect message dispatch */
-  ctimer_set(&collect_timer, ETC_COLLECT_START_DELAY, collect_timer_cb, NULL);
+  ctimer_set(&round->collect_timer, collect_start_delay(round),
+             collect_timer_cb, round);
 
   /* Trigger event timer manually */
-  event_timer_cb(NULL);
+  event_timer_cb(round);
 
   return true;
 }
 
-bool etc_command(const linkaddr_t *receiver, enum command_type_t command,
-                 uint32_t threshold) {
+bool etc_command(uint16_t event_seqn, uint8_t event_source, uint8_t receiver,
+                 enum command_type_t command, uint32_t threshold) {
   struct unicast_hdr_t header;
   struct command_msg_t command_msg;
   struct forward_t *forward = forward_find(receiver);
+  size_t i;
 
   /* Prepare header */
   header.type = UNICAST_MSG_TYPE_COMMAND;
   header.hops = 0;
+  header.route_length = 0;
 
   /* Prepare command message */
-  command_msg.event_seqn = event.seqn;
-  linkaddr_copy(&command_msg.event_source, &event.source);
-  linkaddr_copy(&command_msg.receiver, receiver);
+  command_msg.event_seqn = event_seqn;
+  command_msg.event_source = event_source;
+  command_msg.receiver = receiver;
   command_msg.command = command;
   command_msg.threshold = threshold;
 
+  /* Source route (reverse of the recorded route) */
+  if (forward != NULL) {
+    header.route_length = forward->route_length;
+    for (i = 0; i < forward->route_length; ++i)
+      linkaddr_copy(&header.route[i],
+                    &forward->route[forward->route_length - 1 - i]);
+  }
+  if (header.route_length > 0)
+    return send_command_message(&header, &command_msg, &header.route[0]);
+
   /* Check if forwarding rule exists */
   if (forward == NULL ||
       linkaddr_cmp(&forward->hops[0].address, &linkaddr_null)) {
     LOG_ERROR(
         "Unable to send command message because no forwarding rule has "
-        "been found for sensor %02x:%02x",
-        receiver->u8[0], receiver->u8[1]);
+        "been found for sensor %u",
+        receiver);
     return false;
   }
 
@@ -279,21 +654,171 @@ bool etc_command(const linkaddr_t *receiver, enum command_type_t command,
   return send_command_message(&header, &command_msg, &forward->hops[0].address);
 }
 
+bool etc_collect_request(uint16_t event_seqn, uint8_t event_source,
+                         const uint8_t *sensors) {
+  struct round_t *round = round_find(event_seqn, event_source);
+
+  if (round != NULL) {
+    round->request_received = true;
+    memcpy(round->request, sensors, sizeof(round->request));
+  }
+
+  return send_collect_request_message(event_seqn, event_source, sensors);
+}
+
+bool etc_round_end(uint16_t event_seqn, uint8_t event_source,
+                   const uint8_t *collected,
+                   const struct command_entry_t *commands,
+                   uint8_t num_commands) {
+  struct round_end_msg_t round_end_msg;
+  struct round_t *round = round_find(event_seqn, event_source);
+
+  /* Prepare round end message */
+  round_end_msg.event_seqn = event_seqn;
+  round_end_msg.event_source = event_source;
+  memcpy(round_end_msg.collected, collected, sizeof(round_end_msg.collected));
+  round_end_msg.num_commands = MIN(num_commands, ETC_COMMAND_BUNDLE_MAX_SIZE);
+  memcpy(round_end_msg.commands, commands,
+         round_end_msg.num_commands * sizeof(struct command_entry_t));
+
+  /* Do not propagate echoes */
+  round_end_new(&round_end_msg);
+
+  if (round != NULL) round_end(round);
+
+  return send_round_end_message(&round_end_msg);
+}
+
+/* --- ROUND --- */
+static struct round_t *round_find(uint16_t event_seqn, uint8_t event_source) {
+  size_t i;
+
+  for (i = 0; i < ETC_MAX_ROUNDS; ++i) {
+    if (rounds[i].event.source != REGISTRY_SLOT_NONE &&
+        rounds[i].event.seqn == event_seqn &&
+        rounds[i].event.source == event_source)
+      return &rounds[i];
+  }
+
+  return NULL;
+}
+
+static struct round_t *round_find_source(uint8_t event_source) {
+  size_t i;
+
+  for (i = 0; i < ETC_MAX_ROUNDS; ++i) {
+    if (rounds[i].event.source != REGISTRY_SLOT_NONE &&
+        rounds[i].event.source == event_source)
+      return &rounds[i];
+  }
+
+  return NULL;
+}
+
+static struct round_t *round_new(uint16_t event_seqn, uint8_t event_source,
+                                 enum event_priority_t priority,
+                                 clock_time_t lifetime) {
+  struct round_t *round = NULL;
+  size_t i;
+
+  /* Find free round */
+  for (i = 0; i < ETC_MAX_ROUNDS && round == NULL; ++i) {
+    if (rounds[i].event.source == REGISTRY_SLOT_NONE) round = &rounds[i];
+  }
+
+  /* Preempt a lower priority round */
+  for (i = 0; i < ETC_MAX_ROUNDS && round == NULL; ++i) {
+    if (rounds[i].event.priority >= priority) continue;
+    round = &rounds[i];
+    LOG_INFO("Preempting round of event { seqn: %u, source: %u }",
+             round->event.seqn, round->event.source);
+    round_free(round);
+  }
+  if (round == NULL) return NULL;
+
+  /* Event */
+  round->event.seqn = event_seqn;
+  round->event.source = event_source;
+  round->event.priority = priority;
+  round->event.time = clock_time();
+  last_event = round->event;
+
+  /* State */
+  round->ended = false;
+  round->event_copies = 0;
+  round->num_readings = 0;
+  round->reading_seen = false;
+  round->reading_sent = false;
+  round->unchanged_sent = false;
+  round->request_received = false;
+  aggregation_reset(round);
+
+  /* Safety ceiling */
+  ctimer_set(&round->lifetime_timer, lifetime, round_lifetime_cb, round);
+
+  return round;
+}
+
+static void round_end(struct round_t *round) {
+  /* Already complete */
+  if (round->ended) return;
+  round->ended = true;
+
+  LOG_INFO("Round of event { seqn: %u, source: %u } is complete",
+           round->event.seqn, round->event.source);
+
+  /* Schedule free */
+  ctimer_set(&round->lifetime_timer, ETC_SUPPRESSION_EVENT_PROPAGATION_END,
+             round_lifetime_cb, round);
+}
+
+static void round_collected(struct round_t *round, const uint8_t *collected) {
+  const uint8_t slot = registry_find(&linkaddr_node_addr);
+
+  /* Not a Sensor node or no own reading sent */
+  if (slot == REGISTRY_SLOT_NONE ||
+      (!round->reading_sent && !round->unchanged_sent))
+    return;
+
+  if (!(collected[slot / 8] & (1 << (slot % 8)))) {
+    /* Lost: send the next reading in full */
+    acked.available = false;
+  } else if (round->reading_sent) {
+    acked.available = true;
+    acked.value = round->sent_value;
+    acked.threshold = round->sent_threshold;
+  }
+}
+
+static void round_lifetime_cb(void *ptr) { round_free((struct round_t *)ptr); }
+
+static void round_free(struct round_t *round) {
+  LOG_DEBUG("Freeing round of event { seqn: %u, source: %u }",
+            round->event.seqn, round->event.source);
+
+  /* Timers */
+  ctimer_stop(&round->lifetime_timer);
+  ctimer_stop(&round->event_timer);
+  ctimer_stop(&round->request_timer);
+  ctimer_stop(&round->collect_timer);
+  ctimer_stop(&round->aggregation_timer);
+
+  /* Purge buffered collect message(s) */
+  connection_unicast_purge(round->event.seqn, round->event.source);
+
+  round->event.source = REGISTRY_SLOT_NONE;
+}
+
 /* --- EVENT MESSAGE --- */
 void event_msg_cb(const struct broadcast_hdr_t *header,
                   const linkaddr_t *sender) {
   struct event_msg_t event_msg;
+  struct round_t *round;
   const enum node_role_t node_role = node_get_role();
 
-  /* Ignore if suppression is active */
-  if (!ctimer_expired(&suppression_timer_new) ||
-      !ctimer_expired(&suppression_timer_propagation)) {
-    LOG_WARN("Event message propagation is suppressed");
-    return;
-  }
-
   /* Check received event message validity */
-  if (packetbuf_datalen() != sizeof(event_msg)) {
+  if (packetbuf_datalen() < EVENT_MSG_SIZE(0) ||
+      packetbuf_datalen() > sizeof(event_msg)) {
     LOG_ERROR("Received event message wrong size: %u byte",
               packetbuf_datalen());
     return;
@@ -302,108 +827,244 @@ void event_msg_cb(const struct broadcast_hdr_t *header,
   /* Copy event message */
   packetbuf_copyto(&event_msg);
 
+  /* Check readings */
+  if (event_msg.num_readings > ETC_EVENT_PIGGYBACK_MAX_SIZE ||
+      packetbuf_datalen() != EVENT_MSG_SIZE(event_msg.num_readings)) {
+    LOG_ERROR("Received event message wrong readings: %u in %u byte",
+              event_msg.num_readings, packetbuf_datalen());
+    return;
+  }
+
   LOG_INFO(
       "Received event message from %02x:%02x: "
-      "{ seqn: %u, source: %02x:%02x }",
-      sender->u8[0], sender->u8[1], event_msg.seqn, event_msg.source.u8[0],
-      event_msg.source.u8[1]);
+      "{ seqn: %u, source: %u, priority: %u, readings: %u }",
+      sender->u8[0], sender->u8[1], event_msg.seqn, event_msg.source,
+      event_msg.priority, event_msg.num_readings);
 
   /* Ignore if already handling event */
-  if (event_msg.seqn == event.seqn &&
-      linkaddr_cmp(&event_msg.source, &event.source)) {
-    LOG_WARN("Already handling event: { seqn: %u, source: %02x:%02x }",
-             event_msg.seqn, event_msg.source.u8[0], event_msg.source.u8[1]);
+  round = round_find(event_msg.seqn, event_msg.source);
+  if (round != NULL) {
+    LOG_WARN("Already handling event: { seqn: %u, source: %u }",
+             event_msg.seqn, event_msg.source);
+
+    /* Readings of further copies */
+    piggyback_recv(round, &event_msg, sender);
+
+    /* Count copy if rebroadcast is pending */
+    if (ctimer_expired(&round->event_timer)) return;
+    /* Rebroadcast of the Controller node acknowledges readings */
+    if (ETC_EVENT_PIGGYBACK && node_role == NODE_ROLE_CONTROLLER) return;
+    round->event_copies += 1;
+
+    /* Enough neighbors already rebroadcast */
+    if (round->event_copies >= event_suppression_counter()) {
+      LOG_INFO("Cancelling event message rebroadcast: %u copies overheard",
+               round->event_copies);
+      ctimer_stop(&round->event_timer);
+    }
     return;
   }
 
-  /* Update event */
-  event.seqn = event_msg.seqn;
-  linkaddr_copy(&event.source, &event_msg.source);
+  /* Check event source */
+  if (event_msg.source >= MAX_SENSORS) {
+    LOG_WARN("Event message has invalid source: %u", event_msg.source);
+    return;
+  }
+
+  /* Ignore if old (keep in mind seqn overflow) */
+  if ((int16_t)(event_msg.seqn - last_seqns[event_msg.source]) <= 0) {
+    LOG_WARN("Event { seqn: %u, source: %u } is old: last seqn is %u",
+             event_msg.seqn, event_msg.source, last_seqns[event_msg.source]);
+    return;
+  }
+
+  /* Replace older event of the same source */
+  round = round_find_source(event_msg.source);
+  if (round != NULL) round_free(round);
+
+  /* Start round (suppressed if too many rounds in flight) */
+  round = round_new(event_msg.seqn, event_msg.source,
+                    event_msg.priority == EVENT_PRIORITY_CRITICAL
+                        ? EVENT_PRIORITY_CRITICAL
+                        : EVENT_PRIORITY_NORMAL,
+                    ETC_SUPPRESSION_EVENT_PROPAGATION);
+  if (round == NULL) {
+    LOG_WARN("Event message propagation is suppressed: %u rounds in flight",
+             ETC_MAX_ROUNDS);
+    return;
+  }
+  last_seqns[event_msg.source] = event_msg.seqn;
 
   /* If controller forward to event callback */
   if (node_role == NODE_ROLE_CONTROLLER) {
-    cb->event_cb(event.seqn, &event.source);
+    cb->event_cb(round->event.seqn, round->event.source,
+                 round->event.priority);
   }
 
-  /* Start to suppress new event message(s) */
-  ctimer_set(&suppression_timer_propagation, ETC_SUPPRESSION_EVENT_PROPAGATION,
-             NULL, NULL);
+  /* Readings */
+  piggyback_recv(round, &event_msg, sender);
 
   /* Schedule event message propagation */
-  ctimer_set(&event_timer, ETC_EVENT_FORWARD_DELAY, event_timer_cb, NULL);
+  ctimer_set(&round->event_timer,
+             ETC_EVENT_PIGGYBACK && node_role == NODE_ROLE_CONTROLLER
+                 ? ETC_EVENT_PIGGYBACK_ECHO_DELAY
+                 : ETC_EVENT_FORWARD_DELAY,
+             event_timer_cb, round);
 
   /* Schedule collect message only if sensor/actuator */
   if (node_role == NODE_ROLE_SENSOR_ACTUATOR) {
     /* Schedule collect message dispatch */
-    ctimer_set(&collect_timer, ETC_COLLECT_START_DELAY, collect_timer_cb, NULL);
+    ctimer_set(&round->collect_timer, collect_start_delay(round),
+               collect_timer_cb, round);
   }
 }
 
-static void event_timer_cb(void *ignored) {
+static void event_timer_cb(void *ptr) {
+  struct round_t *round = (struct round_t *)ptr;
+  const uint8_t slot = registry_find(&linkaddr_node_addr);
+  struct event_reading_t *reading;
+  size_t i;
+
   /* Prepare event message */
   struct event_msg_t event_msg;
-  event_msg.seqn = event.seqn;
-  linkaddr_copy(&event_msg.source, &event.source);
+  event_msg.seqn = round->event.seqn;
+  event_msg.source = round->event.source;
+  event_msg.priority = round->event.priority;
+  event_msg.num_readings = 0;
+
+  /* Piggyback readings */
+  if (ETC_EVENT_PIGGYBACK) {
+    /* Own reading first */
+    if (node_get_role() == NODE_ROLE_SENSOR_ACTUATOR &&
+        slot != REGISTRY_SLOT_NONE) {
+      reading = &event_msg.readings[event_msg.num_readings++];
+      reading->sender = slot;
+      reading->value = sensor_value;
+      reading->threshold = sensor_threshold;
+      round->reading_sent = true;
+      round->sent_value = sensor_value;
+      round->sent_threshold = sensor_threshold;
+    }
+
+    /* Overheard readings */
+    for (i = 0; i < round->num_readings &&
+                event_msg.num_readings < ETC_EVENT_PIGGYBACK_MAX_SIZE;
+         ++i) {
+      if (round->readings[i].sender == slot) continue;
+      event_msg.readings[event_msg.num_readings++] = round->readings[i];
+    }
+  }
 
   /* Send event message */
   send_event_message(&event_msg);
 }
 
+static uint8_t event_suppression_counter(void) {
+  const size_t neighbors = neighbor_length();
+
+  /* Sparse: always rebroadcast */
+  if (neighbors < ETC_EVENT_SUPPRESSION_MIN_NEIGHBORS) return UINT8_MAX;
+
+  /* Dense: fewer copies are enough */
+  if (neighbors >= CONNECTION_NEIGHBOR_MAX_SIZE)
+    return MIN(ETC_EVENT_SUPPRESSION_COUNTER, 2);
+
+  return ETC_EVENT_SUPPRESSION_COUNTER;
+}
+
 static bool send_event_message(const struct event_msg_t *event_msg) {
   /* Prepare packetbuf */
   packetbuf_clear();
-  packetbuf_copyfrom(event_msg, sizeof(struct event_msg_t));
+  packetbuf_copyfrom(event_msg, EVENT_MSG_SIZE(event_msg->num_readings));
 
   /* Send event message in broadcast */
   const bool ret = connection_broadcast_send(BROADCAST_MSG_TYPE_EVENT);
   if (!ret)
     LOG_ERROR("Error sending event message: %d", ret);
   else
-    LOG_INFO("Sending event message: { seqn: %u, source: %02x:%02x }",
-             event_msg->seqn, event_msg->source.u8[0], event_msg->source.u8[1]);
+    LOG_INFO("Sending event message: { seqn: %u, source: %u, readings: %u }",
+             event_msg->seqn, event_msg->source, event_msg->num_readings);
 
   return ret;
 }
 
+static void piggyback_recv(struct round_t *round,
+                           const struct event_msg_t *event_msg,
+                           const linkaddr_t *sender) {
+  const uint8_t slot = registry_find(&linkaddr_node_addr);
+  const struct event_reading_t *reading;
+  size_t i;
+  size_t j;
+
+  if (!ETC_EVENT_PIGGYBACK) return;
+
+  for (i = 0; i < event_msg->num_readings; ++i) {
+    reading = &event_msg->readings[i];
+
+    /* Own reading */
+    if (reading->sender == slot) {
+      if (linkaddr_cmp(sender, &CONTROLLER)) round->reading_seen = true;
+      continue;
+    }
+
+    /* Find reading of sender */
+    for (j = 0; j < round->num_readings; ++j) {
+      if (round->readings[j].sender == reading->sender) break;
+    }
+
+    /* Ignore if unchanged */
+    if (j < round->num_readings &&
+        round->readings[j].value == reading->value &&
+        round->readings[j].threshold == reading->threshold)
+      continue;
+
+    /* If controller forward to collect callback */
+    if (node_get_role() == NODE_ROLE_CONTROLLER)
+      cb->collect_cb(round->event.seqn, round->event.source, reading->sender,
+                     reading->value, reading->threshold);
+
+    /* Save (or append if space) */
+    if (j == round->num_readings) {
+      if (round->num_readings >= ETC_EVENT_PIGGYBACK_MAX_SIZE) continue;
+      round->num_readings += 1;
+    }
+    round->readings[j] = *reading;
+  }
+}
+
 /* --- COLLECT MESSAGE --- */
 static void collect_msg_cb(const struct unicast_hdr_t *header,
                            const linkaddr_t *sender) {
   struct collect_msg_t collect_msg;
-
-  /* Check received collect message validity */
-  if (packetbuf_datalen() != sizeof(collect_msg)) {
-    LOG_ERROR("Received collect message wrong size: %u byte",
+  struct round_t *round;
+  const struct collect_reading_t *reading;
+  uint8_t hops;
+  size_t i;
+
+  /* Decode collect message */
+  if (!codec_collect_unpack(&collect_msg, packetbuf_dataptr(),
+                            packetbuf_datalen())) {
+    LOG_ERROR("Received collect message malformed: %u byte",
               packetbuf_datalen());
     return;
   }
 
-  /* Copy collect message */
-  packetbuf_copyto(&collect_msg);
-
   LOG_INFO(
       "Received collect message from %02x:%02x: "
-      "{ event_seqn: %u, event_source: %02x:%02x, "
-      "sender: %02x:%02x, value: %lu, threshold: %lu}",
+      "{ event_seqn: %u, event_source: %u, readings: %u }",
       sender->u8[0], sender->u8[1], collect_msg.event_seqn,
-      collect_msg.event_source.u8[0], collect_msg.event_source.u8[1],
-      collect_msg.sender.u8[0], collect_msg.sender.u8[1], collect_msg.value,
-      collect_msg.threshold);
-
-  /* Update forwarding rule */
-  forward_add(&collect_msg.sender, sender, header->hops);
+      collect_msg.event_source, collect_msg.num_readings);
 
-  /* Ignore if not current event */
-  if (collect_msg.event_seqn != event.seqn ||
-      !linkaddr_cmp(&collect_msg.event_source, &event.source)) {
-    LOG_WARN(
-        "Collect message event { seqn: %u, source: %02x:%02x } is not "
-        "currently handled event { seqn: %u, source: %02x:%02x }",
-        collect_msg.event_seqn, collect_msg.event_source.u8[0],
-        collect_msg.event_source.u8[1], event.seqn, event.source.u8[0],
-        event.source.u8[1]);
-    return;
+  /* Update forwarding rule(s) */
+  for (i = 0; i < collect_msg.num_readings; ++i) {
+    reading = &collect_msg.readings[i];
+    hops = MIN((uint16_t)header->hops + reading->hops, UINT8_MAX);
+    forward_add(reading->sender, sender, hops);
   }
 
+  /* Event in flight */
+  round = round_find(collect_msg.event_seqn, collect_msg.event_source);
+
   /* Forward based on node role */
   switch (node_get_role()) {
     case NODE_ROLE_SENSOR_ACTUATOR:
@@ -416,16 +1077,63 @@ static void collect_msg_cb(const struct unicast_hdr_t *header,
         return;
       }
 
-      /* Forward collect message to parent node */
-      send_collect_message(header, &collect_msg,
-                           &connection_get_conn()->parent_node);
+      /* Forward as is if event not in flight (nothing to aggregate with) */
+      if (round == NULL) {
+        collect_forward(header, &collect_msg);
+        break;
+      }
+
+      /* Aggregate unchanged readings for parent node */
+      for (i = 0; i < MAX_SENSORS; ++i) {
+        if (collect_msg.unchanged[i / 8] & (1 << (i % 8)))
+          aggregation_add_unchanged(round, i);
+      }
+
+      /* Aggregate readings for parent node */
+      for (i = 0; i < collect_msg.num_readings; ++i) {
+        reading = &collect_msg.readings[i];
+        hops = MIN((uint16_t)header->hops + reading->hops, UINT8_MAX);
+
+        /* Check hop counter */
+        if (hops >= CONNECTION_MAX_HOPS) {
+          LOG_WARN(
+              "Collect reading of sensor %u has reached the maximum number "
+              "of hops allowed: %u/%u",
+              reading->sender, hops, CONNECTION_MAX_HOPS);
+          continue;
+        }
+
+        aggregation_add(round, header, reading->sender, reading->value,
+                        reading->threshold, hops);
+      }
       break;
     }
     case NODE_ROLE_CONTROLLER: {
-      /* Forward to collect callback */
-      cb->collect_cb(collect_msg.event_seqn, &collect_msg.event_source,
-                     &collect_msg.sender, collect_msg.value,
-                     collect_msg.threshold);
+      /* Ignore if event not in flight */
+      if (round == NULL) {
+        LOG_WARN(
+            "Collect message event { seqn: %u, source: %u } is not currently "
+            "handled",
+            collect_msg.event_seqn, collect_msg.event_source);
+        return;
+      }
+
+      /* Forward each reading to collect callback */
+      for (i = 0; i < collect_msg.num_readings; ++i) {
+        reading = &collect_msg.readings[i];
+        /* Save route for commands (if recorded from the sensor) */
+        forward_set_route(reading->sender, header->route,
+                          header->route_length);
+        cb->collect_cb(collect_msg.event_seqn, collect_msg.event_source,
+                       reading->sender, reading->value, reading->threshold);
+      }
+
+      /* Forward each unchanged reading to unchanged callback */
+      if (cb->unchanged_cb == NULL) break;
+      for (i = 0; i < MAX_SENSORS; ++i) {
+        if (collect_msg.unchanged[i / 8] & (1 << (i % 8)))
+          cb->unchanged_cb(collect_msg.event_seqn, collect_msg.event_source, i);
+      }
       break;
     }
     default:
@@ -434,28 +1142,208 @@ static void collect_msg_cb(const struct unicast_hdr_t *header,
   }
 }
 
-static void collect_timer_cb(void *ignored) {
-  /* Prepare header */
-  struct unicast_hdr_t header;
-  header.type = UNICAST_MSG_TYPE_COLLECT;
-  header.hops = 0;
+static void collect_forward(const struct unicast_hdr_t *header,
+                            struct collect_msg_t *collect_msg) {
+  struct unicast_hdr_t forward_header;
+  const struct collect_reading_t *reading;
+  uint8_t num_readings = 0;
+  uint8_t hops;
+  size_t i;
 
-  /* Prepare collect message */
-  struct collect_msg_t collect_msg;
-  collect_msg.event_seqn = event.seqn;
-  linkaddr_copy(&collect_msg.event_source, &event.source);
-  linkaddr_copy(&collect_msg.sender, &linkaddr_node_addr);
-  collect_msg.value = sensor_value;
-  collect_msg.threshold = sensor_threshold;
+  LOG_INFO(
+      "Forwarding collect message of event { seqn: %u, source: %u } not in "
+      "flight",
+      collect_msg->event_seqn, collect_msg->event_source);
+
+  /* Hop counts from the senders are carried by the readings */
+  for (i = 0; i < collect_msg->num_readings; ++i) {
+    reading = &collect_msg->readings[i];
+    hops = MIN((uint16_t)header->hops + reading->hops, UINT8_MAX);
+
+    /* Check hop counter */
+    if (hops >= CONNECTION_MAX_HOPS) {
+      LOG_WARN(
+          "Collect reading of sensor %u has reached the maximum number of "
+          "hops allowed: %u/%u",
+          reading->sender, hops, CONNECTION_MAX_HOPS);
+      continue;
+    }
+
+    collect_msg->readings[num_readings] = *reading;
+    collect_msg->readings[num_readings].hops = hops;
+    num_readings += 1;
+  }
+  collect_msg->num_readings = num_readings;
+
+  /* Keep the recorded route */
+  memcpy(&forward_header, header, UNICAST_HDR_SIZE(header->route_length));
+  forward_header.hops = 0;
+
+  send_collect_message(&forward_header, collect_msg,
+                       &connection_get_conn()->parent_node,
+                       clock_time() + ETC_COLLECT_DEADLINE);
+}
+
+static void collect_timer_cb(void *ptr) {
+  struct round_t *round = (struct round_t *)ptr;
+  const uint8_t slot = registry_find(&linkaddr_node_addr);
+
+  /* Not registered */
+  if (slot == REGISTRY_SLOT_NONE) {
+    LOG_WARN("Unable to collect because the node is not registered");
+    return;
+  }
+
+  /* Already received on the event flood */
+  if (round->reading_seen) {
+    LOG_INFO("Skipping collect because the reading has already been seen");
+    return;
+  }
+
+  /* Not requested */
+  if (round->request_received &&
+      !(round->request[slot / 8] & (1 << (slot % 8)))) {
+    LOG_INFO("Skipping collect because the reading has not been requested");
+    return;
+  }
+
+  /* Unchanged since acknowledged */
+  if (reading_unchanged()) {
+    round->unchanged_sent = true;
+    aggregation_add_unchanged(round, slot);
+    return;
+  }
+
+  /* Aggregate own reading */
+  round->reading_sent = true;
+  round->sent_value = sensor_value;
+  round->sent_threshold = sensor_threshold;
+  aggregation_add(round, NULL, slot, sensor_value, sensor_threshold, 0);
+}
+
+static clock_time_t collect_start_delay(const struct round_t *round) {
+  const uint16_t depth =
+      MIN(connection_get_conn()->hopn, (uint16_t)ETC_COLLECT_MAX_DEPTH);
+  const clock_time_t start =
+      round->event.time + ETC_COLLECT_FLOOD_TIME +
+      (ETC_COLLECT_MAX_DEPTH - depth) * ETC_COLLECT_SLOT +
+      random_rand() % ETC_COLLECT_SLOT;
+  const clock_time_t elapsed = clock_time() - round->event.time;
+
+  /* Slot already started (keep in mind clock overflow) */
+  if ((clock_time_t)(start - round->event.time) <= elapsed) return 0;
+
+  return start - clock_time();
+}
+
+static void aggregation_add(struct round_t *round,
+                            const struct unicast_hdr_t *header, uint8_t sender,
+                            uint32_t value, uint32_t threshold, uint8_t hops) {
+  struct collect_msg_t *aggregation = &round->aggregation;
+  struct collect_reading_t *reading;
+  size_t i;
+
+  /* Route of first reading */
+  if (aggregation->num_readings == 0 && header != NULL) {
+    memcpy(&round->aggregation_header, header,
+           UNICAST_HDR_SIZE(header->route_length));
+    round->aggregation_header.hops = 0;
+  }
+
+  /* Find reading of sender or append */
+  for (i = 0; i < aggregation->num_readings; ++i) {
+    if (aggregation->readings[i].sender == sender) break;
+  }
+  if (i == aggregation->num_readings) aggregation->num_readings += 1;
+
+  /* Save (full reading wins over unchanged) */
+  aggregation->unchanged[sender / 8] &= ~(1 << (sender % 8));
+  reading = &aggregation->readings[i];
+  reading->sender = sender;
+  reading->value = value;
+  reading->threshold = threshold;
+  reading->hops = hops;
+
+  LOG_DEBUG("Aggregated collect reading of sensor %u: %u/%u", sender,
+            aggregation->num_readings, ETC_COLLECT_AGGREGATION_MAX_SIZE);
+
+  if (aggregation->num_readings >= ETC_COLLECT_AGGREGATION_MAX_SIZE) {
+    /* Full: forward now */
+    aggregation_flush(round);
+  } else if (ctimer_expired(&round->aggregation_timer)) {
+    /* First reading: wait for further readings */
+    ctimer_set(&round->aggregation_timer, ETC_COLLECT_AGGREGATION_WINDOW,
+               aggregation_timer_cb, round);
+  }
+}
+
+static void aggregation_add_unchanged(struct round_t *round, uint8_t sender) {
+  struct collect_msg_t *aggregation = &round->aggregation;
+  size_t i;
+
+  /* Ignore if full reading of sender already aggregated */
+  for (i = 0; i < aggregation->num_readings; ++i) {
+    if (aggregation->readings[i].sender == sender) return;
+  }
+
+  aggregation->unchanged[sender / 8] |= 1 << (sender % 8);
+
+  LOG_DEBUG("Aggregated unchanged reading of sensor %u", sender);
+
+  /* Wait for further readings */
+  if (ctimer_expired(&round->aggregation_timer))
+    ctimer_set(&round->aggregation_timer, ETC_COLLECT_AGGREGATION_WINDOW,
+               aggregation_timer_cb, round);
+}
+
+static bool reading_unchanged(void) {
+  const uint32_t delta = sensor_value > acked.value
+                             ? sensor_value - acked.value
+                             : acked.value - sensor_value;
+
+  return acked.available && sensor_value <= sensor_threshold &&
+         acked.threshold == sensor_threshold && delta <= ETC_COLLECT_DELTA;
+}
+
+static void aggregation_timer_cb(void *ptr) {
+  aggregation_flush((struct round_t *)ptr);
+}
+
+static void aggregation_flush(struct round_t *round) {
+  size_t i;
+
+  ctimer_stop(&round->aggregation_timer);
+
+  /* Nothing to forward */
+  for (i = 0; i < CONNECTION_SUBTREE_SIZE; ++i) {
+    if (round->aggregation.unchanged[i] != 0) break;
+  }
+  if (round->aggregation.num_readings == 0 && i == CONNECTION_SUBTREE_SIZE)
+    return;
 
   /* Send collect message */
-  send_collect_message(&header, &collect_msg,
-                       &connection_get_conn()->parent_node);
+  send_collect_message(&round->aggregation_header, &round->aggregation,
+                       &connection_get_conn()->parent_node,
+                       round->event.time + ETC_COLLECT_DEADLINE);
+
+  aggregation_reset(round);
+}
+
+static void aggregation_reset(struct round_t *round) {
+  round->aggregation.event_seqn = round->event.seqn;
+  round->aggregation.event_source = round->event.source;
+  memset(round->aggregation.unchanged, 0,
+         sizeof(round->aggregation.unchanged));
+  round->aggregation.num_readings = 0;
+  round->aggregation_header.type = UNICAST_MSG_TYPE_COLLECT;
+  round->aggregation_header.hops = 0;
+  round->aggregation_header.route_length = 0;
 }
 
 static bool send_collect_message(const struct unicast_hdr_t *header,
                                  const struct collect_msg_t *collect_msg,
-                                 const linkaddr_t *receiver) {
+                                 const linkaddr_t *receiver,
+                                 clock_time_t deadline) {
   /* Check connection */
   if (!connection_is_connected()) {
     LOG_WARN(
@@ -466,29 +1354,220 @@ static bool send_collect_message(const struct unicast_hdr_t *header,
 
   /* Prepare packetbuf */
   packetbuf_clear();
-  packetbuf_copyfrom(collect_msg, sizeof(struct collect_msg_t));
+  packetbuf_set_datalen(
+      codec_collect_pack(packetbuf_dataptr(), PACKETBUF_SIZE, collect_msg));
+  if (packetbuf_datalen() == 0) {
+    LOG_ERROR("Collect message does not fit in packetbuf: { readings: %u }",
+              collect_msg->num_readings);
+    return false;
+  }
 
   /* Send collect message in unicast to receiver node */
-  const bool ret = connection_unicast_send(header, receiver);
+  const bool ret = connection_unicast_send(header, receiver, deadline);
   if (!ret)
     LOG_ERROR(
         "Error sending collect message to %02x:%02x: "
-        "{ event_seqn: %u, event_source: %02x:%02x, "
-        "sender: %02x:%02x, value: %lu, threshold: %lu}",
+        "{ event_seqn: %u, event_source: %u, readings: %u }",
         receiver->u8[0], receiver->u8[1], collect_msg->event_seqn,
-        collect_msg->event_source.u8[0], collect_msg->event_source.u8[1],
-        collect_msg->sender.u8[0], collect_msg->sender.u8[1],
-        collect_msg->value, collect_msg->threshold);
+        collect_msg->event_source, collect_msg->num_readings);
   else {
     LOG_INFO(
         "Sending collect message to %02x:%02x: "
-        "{ event_seqn: %u, event_source: %02x:%02x, "
-        "sender: %02x:%02x, value: %lu, threshold: %lu}",
+        "{ event_seqn: %u, event_source: %u, readings: %u }",
         receiver->u8[0], receiver->u8[1], collect_msg->event_seqn,
-        collect_msg->event_source.u8[0], collect_msg->event_source.u8[1],
-        collect_msg->sender.u8[0], collect_msg->sender.u8[1],
-        collect_msg->value, collect_msg->threshold);
+        collect_msg->event_source, collect_msg->num_readings);
+  }
+
+  return ret;
+}
+
+/* --- COLLECT REQUEST MESSAGE --- */
+static void collect_request_msg_cb(const struct broadcast_hdr_t *header,
+                                   const linkaddr_t *sender) {
+  struct collect_request_msg_t request_msg;
+  struct round_t *round;
+
+  /* Check received collect request message validity */
+  if (packetbuf_datalen() != sizeof(request_msg)) {
+    LOG_ERROR("Received collect request message wrong size: %u byte",
+              packetbuf_datalen());
+    return;
+  }
+
+  /* Copy collect request message */
+  packetbuf_copyto(&request_msg);
+
+  LOG_INFO(
+      "Received collect request message from %02x:%02x: "
+      "{ event_seqn: %u, event_source: %u }",
+      sender->u8[0], sender->u8[1], request_msg.event_seqn,
+      request_msg.event_source);
+
+  /* Ignore if event not in flight */
+  round = round_find(request_msg.event_seqn, request_msg.event_source);
+  if (round == NULL) {
+    LOG_WARN(
+        "Collect request message event { seqn: %u, source: %u } is not "
+        "currently handled",
+        request_msg.event_seqn, request_msg.event_source);
+    return;
+  }
+
+  /* Ignore if already received */
+  if (round->request_received) return;
+
+  /* Save */
+  round->request_received = true;
+  memcpy(round->request, request_msg.sensors, sizeof(round->request));
+
+  /* Schedule collect request message propagation */
+  ctimer_set(&round->request_timer, ETC_EVENT_FORWARD_DELAY,
+             collect_request_timer_cb, round);
+}
+
+static void collect_request_timer_cb(void *ptr) {
+  const struct round_t *round = (const struct round_t *)ptr;
+
+  send_collect_request_message(round->event.seqn, round->event.source,
+                               round->request);
+}
+
+static bool send_collect_request_message(uint16_t event_seqn,
+                                         uint8_t event_source,
+                                         const uint8_t *sensors) {
+  struct collect_request_msg_t request_msg;
+
+  /* Prepare collect request message */
+  request_msg.event_seqn = event_seqn;
+  request_msg.event_source = event_source;
+  memcpy(request_msg.sensors, sensors, sizeof(request_msg.sensors));
+
+  /* Prepare packetbuf */
+  packetbuf_clear();
+  packetbuf_copyfrom(&request_msg, sizeof(request_msg));
+
+  /* Send collect request message in broadcast */
+  const bool ret =
+      connection_broadcast_send(BROADCAST_MSG_TYPE_COLLECT_REQUEST);
+  if (!ret)
+    LOG_ERROR("Error sending collect request message: %d", ret);
+  else
+    LOG_INFO(
+        "Sending collect request message: "
+        "{ event_seqn: %u, event_source: %u }",
+        request_msg.event_seqn, request_msg.event_source);
+
+  return ret;
+}
+
+/* --- ROUND END MESSAGE --- */
+static void round_end_msg_cb(const struct broadcast_hdr_t *header,
+                             const linkaddr_t *sender) {
+  struct round_end_msg_t round_end_msg;
+  struct command_msg_t command_msg;
+  struct round_t *round;
+  const uint8_t slot = registry_find(&linkaddr_node_addr);
+  size_t i;
+
+  /* Decode round end message */
+  if (!codec_round_end_unpack(&round_end_msg, packetbuf_dataptr(),
+                              packetbuf_datalen())) {
+    LOG_ERROR("Received round end message malformed: %u byte",
+              packetbuf_datalen());
+    return;
+  }
+
+  LOG_INFO(
+      "Received round end message from %02x:%02x: "
+      "{ event_seqn: %u, event_source: %u, commands: %u }",
+      sender->u8[0], sender->u8[1], round_end_msg.event_seqn,
+      round_end_msg.event_source, round_end_msg.num_commands);
+
+  /* Check event source */
+  if (round_end_msg.event_source >= MAX_SENSORS) {
+    LOG_WARN("Round end message has invalid source: %u",
+             round_end_msg.event_source);
+    return;
+  }
+
+  /* Ignore if already propagated */
+  if (!round_end_new(&round_end_msg)) return;
+
+  round = round_find(round_end_msg.event_seqn, round_end_msg.event_source);
+
+  /* Acknowledged reading, then own command (if any) */
+  if (round != NULL) round_collected(round, round_end_msg.collected);
+  for (i = 0; i < round_end_msg.num_commands; ++i) {
+    if (slot == REGISTRY_SLOT_NONE ||
+        round_end_msg.commands[i].receiver != slot)
+      continue;
+
+    command_msg.event_seqn = round_end_msg.event_seqn;
+    command_msg.event_source = round_end_msg.event_source;
+    command_msg.receiver = slot;
+    command_msg.command = round_end_msg.commands[i].command;
+    command_msg.threshold = round_end_msg.commands[i].threshold;
+    command_deliver(round, &command_msg);
+  }
+
+  /* End round (if in flight) */
+  if (round != NULL) round_end(round);
+
+  /* Schedule round end message propagation (even if event not in flight: the
+   * subtree could have bundled commands) */
+  for (i = 0; i < ETC_MAX_ROUNDS; ++i) {
+    if (ctimer_expired(&round_end_relays[i].timer)) break;
   }
+  if (i >= ETC_MAX_ROUNDS) {
+    LOG_WARN("Round end message relays full, replacing a pending one");
+    i = 0;
+  }
+  memcpy(&round_end_relays[i].msg, &round_end_msg, sizeof(round_end_msg));
+  ctimer_set(&round_end_relays[i].timer, ETC_EVENT_FORWARD_DELAY,
+             round_end_timer_cb, &round_end_relays[i]);
+}
+
+static void round_end_timer_cb(void *ptr) {
+  const struct round_end_relay_t *relay = (const struct round_end_relay_t *)ptr;
+
+  send_round_end_message(&relay->msg);
+}
+
+static bool round_end_new(const struct round_end_msg_t *round_end_msg) {
+  uint16_t *end_seqn;
+
+  if (round_end_msg->event_source >= MAX_SENSORS) return false;
+  end_seqn = &end_seqns[round_end_msg->event_source];
+
+  /* Old or already propagated (keep in mind seqn overflow) */
+  if ((int16_t)(round_end_msg->event_seqn - *end_seqn) <= 0) return false;
+
+  *end_seqn = round_end_msg->event_seqn;
+  return true;
+}
+
+static bool send_round_end_message(
+    const struct round_end_msg_t *round_end_msg) {
+  /* Prepare packetbuf */
+  packetbuf_clear();
+  packetbuf_set_datalen(codec_round_end_pack(packetbuf_dataptr(),
+                                             PACKETBUF_SIZE, round_end_msg));
+  if (packetbuf_datalen() == 0) {
+    LOG_ERROR("Round end message does not fit in packetbuf: { commands: %u }",
+              round_end_msg->num_commands);
+    return false;
+  }
+
+  /* Send round end message in broadcast */
+  const bool ret = connection_broadcast_send(BROADCAST_MSG_TYPE_ROUND_END);
+  if (!ret)
+    LOG_ERROR("Error sending round end message: %d", ret);
+  else
+    LOG_INFO(
+        "Sending round end message: "
+        "{ event_seqn: %u, event_source: %u, commands: %u }",
+        round_end_msg->event_seqn, round_end_msg->event_source,
+        round_end_msg->num_commands);
 
   return ret;
 }
@@ -497,37 +1576,44 @@ static bool send_collect_message(const struct unicast_hdr_t *header,
 static void command_msg_cb(const struct unicast_hdr_t *header,
                            const linkaddr_t *sender) {
   struct command_msg_t command_msg;
+  struct round_t *round;
 
-  /* Check received command message validity */
-  if (packetbuf_datalen() != sizeof(command_msg)) {
-    LOG_ERROR("Received command message wrong size: %u byte",
+  /* Decode command message */
+  if (!codec_command_unpack(&command_msg, packetbuf_dataptr(),
+                            packetbuf_datalen())) {
+    LOG_ERROR("Received command message malformed: %u byte",
               packetbuf_datalen());
     return;
   }
 
-  /* Copy command message */
-  packetbuf_copyto(&command_msg);
-
   LOG_INFO(
       "Received command message from %02x:%02x: "
-      "{ receiver: %02x:%02x, command: %d, threshold: %lu, event_seqn: %u, "
-      "event_source: %02x:%02x }",
-      sender->u8[0], sender->u8[1], command_msg.receiver.u8[0],
-      command_msg.receiver.u8[1], command_msg.command, command_msg.threshold,
-      command_msg.event_seqn, command_msg.event_source.u8[0],
-      command_msg.event_source.u8[1]);
-
-  /* Check receiver address */
-  if (!linkaddr_cmp(&command_msg.receiver, &linkaddr_node_addr)) {
+      "{ receiver: %u, command: %d, threshold: %lu, event_seqn: %u, "
+      "event_source: %u }",
+      sender->u8[0], sender->u8[1], command_msg.receiver, command_msg.command,
+      command_msg.threshold, command_msg.event_seqn, command_msg.event_source);
+
+  /* Command(s) could be sent before the round is complete (early actuation):
+   * the round ends with the round end message */
+  round = round_find(command_msg.event_seqn, command_msg.event_source);
+
+  /* Check receiver slot */
+  if (command_msg.receiver != registry_find(&linkaddr_node_addr)) {
+    /* Forward along source route */
+    if (header->route_length > 0) {
+      send_command_message(header, &command_msg, &header->route[0]);
+      return;
+    }
+
     /* Forward */
-    const struct forward_t *forward = forward_find(&command_msg.receiver);
+    const struct forward_t *forward = forward_find(command_msg.receiver);
 
     /* Check if forwarding rule exists */
-    if (forward_hops_length(&command_msg.receiver) == 0) {
+    if (forward_hops_length(command_msg.receiver) == 0) {
       LOG_ERROR(
           "Unable to forward command message because no forwarding rule has "
-          "been found for sensor %02x:%02x",
-          command_msg.receiver.u8[0], command_msg.receiver.u8[1]);
+          "been found for sensor %u",
+          command_msg.receiver);
       return;
     }
 
@@ -537,19 +1623,79 @@ static void command_msg_cb(const struct unicast_hdr_t *header,
   }
 
   /* Me */
-  /* Forward to command callback */
-  cb->command_cb(command_msg.event_seqn, &command_msg.event_source,
-                 command_msg.command, command_msg.threshold);
+  if (command_msg.command == COMMAND_TYPE_PULL)
+    pull_reply(round, &command_msg);
+  else
+    command_deliver(round, &command_msg);
+}
+
+static void pull_reply(struct round_t *round,
+                       const struct command_msg_t *command_msg) {
+  struct unicast_hdr_t header;
+  struct collect_msg_t collect_msg;
+  struct collect_reading_t *reading;
+  const clock_time_t deadline = round != NULL
+                                    ? round->event.time + ETC_COLLECT_DEADLINE
+                                    : clock_time() + ETC_COLLECT_DEADLINE;
+
+  /* Prepare header */
+  header.type = UNICAST_MSG_TYPE_COLLECT;
+  header.hops = 0;
+  header.route_length = 0;
+
+  /* Prepare collect message */
+  collect_msg.event_seqn = command_msg->event_seqn;
+  collect_msg.event_source = command_msg->event_source;
+  memset(collect_msg.unchanged, 0, sizeof(collect_msg.unchanged));
+  collect_msg.num_readings = 1;
+  reading = &collect_msg.readings[0];
+  reading->sender = command_msg->receiver;
+  reading->value = sensor_value;
+  reading->threshold = sensor_threshold;
+  reading->hops = 0;
+
+  LOG_INFO("Pulled reading of event { seqn: %u, source: %u }",
+           command_msg->event_seqn, command_msg->event_source);
+
+  if (!send_collect_message(&header, &collect_msg,
+                            &connection_get_conn()->parent_node, deadline))
+    return;
 
-  /* Schedule stop event propagation suppression */
-  ctimer_set(&suppression_timer_propagation_end,
-             ETC_SUPPRESSION_EVENT_PROPAGATION_END,
-             suppression_timer_propagation_end_cb, NULL);
+  if (round != NULL) {
+    round->reading_sent = true;
+    round->sent_value = sensor_value;
+    round->sent_threshold = sensor_threshold;
+  }
 }
 
-static void suppression_timer_propagation_end_cb(void *ignored) {
-  /* Stop event propagation suppression */
-  ctimer_stop(&suppression_timer_propagation);
+static void command_deliver(struct round_t *round,
+                            const struct command_msg_t *command_msg) {
+  /* The Controller node caches the commanded reading */
+  if (command_msg->command == COMMAND_TYPE_RESET) {
+    acked.available = true;
+    acked.value = 0;
+    acked.threshold = command_msg->threshold;
+    /* Round end could arrive after the command */
+    if (round != NULL) {
+      round->sent_value = 0;
+      round->sent_threshold = command_msg->threshold;
+    }
+  } else if (command_msg->command != COMMAND_TYPE_NONE) {
+    if (round != NULL && round->reading_sent) {
+      acked.available = true;
+      acked.value = round->sent_value;
+      acked.threshold = command_msg->threshold;
+      /* Round end could arrive after the command */
+      round->sent_threshold = command_msg->threshold;
+    } else {
+      /* Commanded value unknown: send the next reading in full */
+      acked.available = false;
+    }
+  }
+
+  /* Forward to command callback */
+  cb->command_cb(command_msg->event_seqn, command_msg->event_source,
+                 command_msg->command, command_msg->threshold);
 }
 
 static bool send_command_message(const struct unicast_hdr_t *header,
@@ -565,28 +1711,32 @@ static bool send_command_message(const struct unicast_hdr_t *header,
 
   /* Prepare packetbuf */
   packetbuf_clear();
-  packetbuf_copyfrom(command_msg, sizeof(struct command_msg_t));
+  packetbuf_set_datalen(
+      codec_command_pack(packetbuf_dataptr(), PACKETBUF_SIZE, command_msg));
+  if (packetbuf_datalen() == 0) {
+    LOG_ERROR("Command message does not fit in packetbuf");
+    return false;
+  }
 
   /* Send command message in unicast to receiver node */
-  const bool ret = connection_unicast_send(header, receiver);
+  const bool ret = connection_unicast_send(
+      header, receiver, clock_time() + ETC_COMMAND_DEADLINE);
   if (!ret)
     LOG_ERROR(
         "Error sending command message to %02x:%02x: "
-        "{ receiver: %02x:%02x, command: %d, threshold: %lu, event_seqn: %u, "
-        "event_source: %02x:%02x }",
-        receiver->u8[0], receiver->u8[1], command_msg->receiver.u8[0],
-        command_msg->receiver.u8[1], command_msg->command,
-        command_msg->threshold, command_msg->event_seqn,
-        command_msg->event_source.u8[0], command_msg->event_source.u8[1]);
+        "{ receiver: %u, command: %d, threshold: %lu, event_seqn: %u, "
+        "event_source: %u }",
+        receiver->u8[0], receiver->u8[1], command_msg->receiver,
+        command_msg->command, command_msg->threshold, command_msg->event_seqn,
+        command_msg->event_source);
   else {
     LOG_INFO(
         "Sending command message to %02x:%02x: "
-        "{ receiver: %02x:%02x, command: %d, threshold: %lu, event_seqn: %u, "
-        "event_source: %02x:%02x }",
-        receiver->u8[0], receiver->u8[1], command_msg->receiver.u8[0],
-        command_msg->receiver.u8[1], command_msg->command,
-        command_msg->threshold, command_msg->event_seqn,
-        command_msg->event_source.u8[0], command_msg->event_source.u8[1]);
+        "{ receiver: %u, command: %d, threshold: %lu, event_seqn: %u, "
+        "event_source: %u }",
+        receiver->u8[0], receiver->u8[1], command_msg->receiver,
+        command_msg->command, command_msg->threshold, command_msg->event_seqn,
+        command_msg->event_source);
   }
 
   return ret;
@@ -601,6 +1751,14 @@ static void bc_recv(const struct broadcast_hdr_t *header,
       event_msg_cb(header, sender);
       break;
     }
+    case BROADCAST_MSG_TYPE_COLLECT_REQUEST: {
+      collect_request_msg_cb(header, sender);
+      break;
+    }
+    case BROADCAST_MSG_TYPE_ROUND_END: {
+      round_end_msg_cb(header, sender);
+      break;
+    }
     default: {
       /* Ignore */
       break;
@@ -17,9 +17,11 @@ struct etc_callbacks_t {
    * After this notification, the Controller waits for sensor readings.
    *
    * @param event_seqn Event sequence number.
-   * @param event_source Address of the sensor that generated the event.
+   * @param event_source Slot of the sensor that generated the event.
+   * @param priority Event priority.
    */
-  void (*event_cb)(uint16_t event_seqn, const linkaddr_t *event_source);
+  void (*event_cb)(uint16_t event_seqn, uint8_t event_source,
+                   enum event_priority_t priority);
 
   /**
    * Data collection reception callback.
@@ -27,25 +29,36 @@ struct etc_callbacks_t {
    * When all readings have been collected, the Controller can send commands.
    *
    * @param event_seqn Event sequence number.
-   * @param event_source Address of the sensor that generated the event.
-   * @param sender Address of the sensor node.
+   * @param event_source Slot of the sensor that generated the event.
+   * @param sender Slot of the sensor node.
    * @param value Sensor value.
    * @param threshold Sensor threshold.
    */
-  void (*collect_cb)(uint16_t event_seqn, const linkaddr_t *event_source,
-                     const linkaddr_t *sender, uint32_t value,
-                     uint32_t threshold);
+  void (*collect_cb)(uint16_t event_seqn, uint8_t event_source, uint8_t sender,
+                     uint32_t value, uint32_t threshold);
+
+  /**
+   * Unchanged data collection reception callback.
+   * Notifies the Controller that the reading of the Sensor is unchanged since
+   * the last acknowledged one (see ETC_COLLECT_DELTA).
+   *
+   * @param event_seqn Event sequence number.
+   * @param event_source Slot of the sensor that generated the event.
+   * @param sender Slot of the sensor node.
+   */
+  void (*unchanged_cb)(uint16_t event_seqn, uint8_t event_source,
+                       uint8_t sender);
 
   /**
    * Command reception callback.
    * Notifies the Sensor/Actuator of a command from the Controller.
    *
    * @param event_seqn Event sequence number.
-   * @param event_source Address of the sensor that generated the event.
+   * @param event_source Slot of the sensor that generated the event.
    * @param command Command type.
    * @param threshold New threshold.
    */
-  void (*command_cb)(uint16_t event_seqn, const linkaddr_t *event_source,
+  void (*command_cb)(uint16_t event_seqn, uint8_t event_source,
                      enum command_type_t command, uint32_t threshold);
 };
 
@@ -55,8 +68,12 @@ struct etc_callbacks_t {
 struct etc_event_t {
   /* Sequence number. */
   uint16_t seqn;
-  /* Address of the generator node. */
-  linkaddr_t source;
+  /* Slot of the generator node. */
+  uint8_t source;
+  /* Priority. */
+  enum event_priority_t priority;
+  /* Local time the event has been detected. */
+  clock_time_t time;
 };
 
 /* --- --- */
@@ -74,7 +91,8 @@ void etc_open(uint16_t channel, const struct etc_callbacks_t *callbacks);
 void etc_close(void);
 
 /**
- * @brief Return the current event.
+ * @brief Return the most recent event.
+ * Other events could still be in flight.
  *
  * @return Evenet data.
  */
@@ -90,27 +108,77 @@ void etc_update(uint32_t value, uint32_t threshold);
 
 /**
  * @brief Start event dissemination.
- * If events are suppressed no dissemination to avoid contention.
- * Used only by Sensor node.
+ * If events are suppressed no dissemination to avoid contention: the own
+ * previous event is still in flight or ETC_MAX_ROUNDS events are in flight.
+ * A critical event (see ETC_EVENT_CRITICAL_MARGIN) is suppressed only by
+ * critical events.
+ * Used only by Sensor node, once registered.
  *
  * @param value Sensed value.
  * @param threshold Current threshold.
  * @return true Started event dissemination.
- * @return false Event(s) are suppressed.
+ * @return false Event(s) are suppressed or the node is not registered.
  */
 bool etc_trigger(uint32_t value, uint32_t threshold);
 
 /**
- * @brief Send the command to the receiver node.
+ * @brief Send the command of an event to the receiver node.
+ * The command can be sent before the round end (early actuation).
+ * A COMMAND_TYPE_PULL command is not delivered: the receiver answers with a
+ * collect message of its current reading.
  * Used only by Controller node.
  *
- * @param receiver Receiver node address.
+ * @param event_seqn Event sequence number.
+ * @param event_source Slot of the sensor that generated the event.
+ * @param receiver Receiver node slot.
  * @param command Command to send.
  * @param threshold New threshold.
  * @return true Command sent.
  * @return false Command not sent.
  */
-bool etc_command(const linkaddr_t *receiver, enum command_type_t command,
-                 uint32_t threshold);
+bool etc_command(uint16_t event_seqn, uint8_t event_source, uint8_t receiver,
+                 enum command_type_t command, uint32_t threshold);
+
+/**
+ * @brief Request the collect of an event to a set of Sensor nodes.
+ * Floods a collect request message, the Sensor nodes not in the bitmap skip
+ * their collect message.
+ * Without a request every Sensor node sends its collect message.
+ * Used only by Controller node.
+ *
+ * @param event_seqn Event sequence number.
+ * @param event_source Slot of the sensor that generated the event.
+ * @param sensors Bitmap of the Sensor nodes that must reply
+ * (CONNECTION_SUBTREE_SIZE byte).
+ * @return true Collect request message sent.
+ * @return false Collect request message not sent due to an error.
+ */
+bool etc_collect_request(uint16_t event_seqn, uint8_t event_source,
+                         const uint8_t *sensors);
+
+/**
+ * @brief End the round of an event.
+ * Floods a round end message so that the nodes free the round.
+ * The message acknowledges the collected readings: a Sensor node sends an
+ * unchanged reading as a bit until its value moves away from the
+ * acknowledged one.
+ * The message bundles the commands of the round: a single flood reaches all
+ * the commanded Sensor nodes.
+ * Used only by Controller node.
+ *
+ * @param event_seqn Event sequence number.
+ * @param event_source Slot of the sensor that generated the event.
+ * @param collected Bitmap of the Sensor nodes whose reading has been received
+ * (CONNECTION_SUBTREE_SIZE byte).
+ * @param commands Commands.
+ * @param num_commands Number of commands (at most
+ * ETC_COMMAND_BUNDLE_MAX_SIZE).
+ * @return true Round end message sent.
+ * @return false Round end message not sent due to an error.
+ */
+bool etc_round_end(uint16_t event_seqn, uint8_t event_source,
+                   const uint8_t *collected,
+                   const struct command_entry_t *commands,
+                   uint8_t num_commands);
 
 #endif
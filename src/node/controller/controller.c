@@ -1,8 +1,10 @@
 #include "controller.h"
 
+#include <string.h>
 #include <sys/cc.h>
 
 #include "config/config.h"
+#include "connection/registry.h"
 #include "etc/etc.h"
 #include "logger/logger.h"
 
@@ -10,45 +12,124 @@
  * @brief Sensor reading.
  */
 struct sensor_reading_t {
-  /* Address of the sensor/actuator node. */
-  linkaddr_t address;
-  /* Event sequence number. */
-  uint16_t seqn;
-  /* Sensor value. */
+  /* Sensor value (as read, also after a RESET command). */
   uint32_t value;
   /* Sensor threshold. */
   uint32_t threshold;
-  /* Flag if data is available. */
-  bool reading_available;
   /* Command to send. */
   enum command_type_t command;
+  /* Flag if data is available. */
+  bool reading_available;
+  /* Flag if data comes from the cache (not requested). */
+  bool reading_cached;
+  /* Flag if the command has been sent. */
+  bool command_sent;
+  /* Flag if the reading has been pulled. */
+  bool pulled;
 };
 
 /**
- * @brief Sensor readings.
- * Save the last reading of i th sensor.
+ * @brief Cached sensor reading.
+ * Last known state of a sensor, kept across rounds.
  */
-static struct sensor_reading_t sensor_readings[NUM_SENSORS];
+struct sensor_cache_t {
+  /* Sensor value. */
+  uint32_t value;
+  /* Sensor threshold. */
+  uint32_t threshold;
+  /* Local time of the reading. */
+  clock_time_t time;
+  /* Flag if data is available. */
+  bool available;
+};
 
 /**
- * @brief Total number of readings from sensors.
+ * @brief Collect delay estimate of a sensor.
+ * Delay from the event detection to the reception of the collect reading.
  */
-static uint8_t num_sensor_readings;
+struct sensor_delay_t {
+  /* Mean delay (EWMA). */
+  clock_time_t mean;
+  /* Mean deviation from the mean delay (EWMA). */
+  clock_time_t deviation;
+  /* Flag if an estimate is available. */
+  bool available;
+};
 
 /**
- * @brief Timer to wait before analyzing received sensor readings.
+ * @brief Event round.
+ * Note that a round with REGISTRY_SLOT_NONE event source is free.
  */
-static struct ctimer collect_timer;
+struct round_t {
+  /* Event sequence number. */
+  uint16_t event_seqn;
+  /* Slot of the sensor that generated the event. */
+  uint8_t event_source;
+  /* Event priority. */
+  enum event_priority_t priority;
+  /* Local time of the event detection. */
+  clock_time_t start;
+  /* Flag if the round has been cut short by a higher priority round. */
+  bool cut_short;
+  /* Flag if the missing readings have been pulled. */
+  bool pulled;
+  /* Sensor readings, the reading of the sensor in registry slot i. */
+  struct sensor_reading_t sensor_readings[MAX_SENSORS];
+  /* Total number of readings from sensors. */
+  uint8_t num_sensor_readings;
+  /* Timer to wait before analyzing received sensor readings. */
+  struct ctimer collect_timer;
+  /* Timer to wait before pulling the missing sensor readings. */
+  struct ctimer pull_timer;
+};
+
+/**
+ * @brief Event rounds in flight.
+ */
+static struct round_t rounds[ETC_MAX_ROUNDS];
+
+/**
+ * @brief Last event sequence number of the sensor in registry slot i.
+ */
+static uint16_t event_seqns[MAX_SENSORS];
+
+/**
+ * @brief Cached reading of the sensor in registry slot i.
+ */
+static struct sensor_cache_t sensor_cache[MAX_SENSORS];
+
+/**
+ * @brief Collect delay estimate of the sensor in registry slot i.
+ */
+static struct sensor_delay_t sensor_delays[MAX_SENSORS];
+
+/**
+ * @brief Number of consecutive rounds with a missed collect of the sensor in
+ * registry slot i (see CONTROLLER_LIVENESS_MAX_MISSED).
+ */
+static uint8_t sensor_missed[MAX_SENSORS];
+
+/* Per sensor tables within their share of the memory budget */
+_Static_assert(ETC_MAX_ROUNDS * sizeof(rounds[0].sensor_readings) +
+                       sizeof(event_seqns) + sizeof(sensor_cache) +
+                       sizeof(sensor_delays) + sizeof(sensor_missed) <=
+                   MAX_SENSORS * SENSORS_MEMORY_CONTROLLER,
+               "SENSORS_MEMORY_CONTROLLER too small");
 
 /**
  * @brief Event detection callback.
  * Notifies of an ongoing event dissemination.
  * After this notification, the controller waits for sensor readings.
  *
+ * A critical event cuts short a round that is not critical if all rounds
+ * are in flight.
+ *
  * @param event_seqn Event sequence number.
- * @param event_source Address of the sensor that generated the event.
+ * @param event_source Slot of the sensor that generated the event.
+ * @param priority Event priority.
  */
-static void event_cb(uint16_t event_seqn, const linkaddr_t *event_source);
+static void event_cb(uint16_t event_seqn, uint8_t event_source,
+                     enum event_priority_t priority);
 
 /**
  * @brief Data collection reception callback.
@@ -56,21 +137,63 @@ static void event_cb(uint16_t event_seqn, const linkaddr_t *event_source);
  * When all readings have been collected, the controller can send commands.
  *
  * @param event_seqn Event sequence number.
- * @param event_source Address of the sensor that generated the event.
- * @param sender Address of the sensor node.
+ * @param event_source Slot of the sensor that generated the event.
+ * @param sender Slot of the sensor node.
+ * @param value Sensor value.
+ * @param threshold Sensor threshold.
+ */
+static void collect_cb(uint16_t event_seqn, uint8_t event_source,
+                       uint8_t sender, uint32_t value, uint32_t threshold);
+
+/**
+ * @brief Unchanged callback.
+ * The reading of the sensor is its cached reading.
+ *
+ * @param event_seqn Event sequence number.
+ * @param event_source Slot of the sensor that generated the event.
+ * @param sender Slot of the sensor with an unchanged reading.
+ */
+static void unchanged_cb(uint16_t event_seqn, uint8_t event_source,
+                         uint8_t sender);
+
+/**
+ * @brief Store the reading of a sensor in the round of the event.
+ * An unchanged reading does not refresh the cached reading: the sensor value
+ * could be up to ETC_COLLECT_DELTA off, the error bound keeps growing from
+ * the time of the cached reading.
+ * A reading that would replace a cached reading already sent an early RESET
+ * is ignored: the RESET is final, the round keeps the reading it was computed
+ * on.
+ *
+ * @param event_seqn Event sequence number.
+ * @param event_source Slot of the sensor that generated the event.
+ * @param sender Slot of the sensor node.
  * @param value Sensor value.
  * @param threshold Sensor threshold.
+ * @param unchanged Flag if the reading is the cached one (unchanged).
  */
-static void collect_cb(uint16_t event_seqn, const linkaddr_t *event_source,
-                       const linkaddr_t *sender, uint32_t value,
-                       uint32_t threshold);
+static void collect_reading(uint16_t event_seqn, uint8_t event_source,
+                            uint8_t sender, uint32_t value, uint32_t threshold,
+                            bool unchanged);
 
 /**
  * @brief Collect timer callback.
+ * Actuates and ends the round.
  *
- * @param ignored
+ * @param ptr Round.
  */
-static void collect_timer_cb(void *ignored);
+static void collect_timer_cb(void *ptr);
+
+/**
+ * @brief Pull timer callback.
+ * Sends a PULL command to the sensors with a missing reading that are not
+ * suspected dead, so that a lost collect is recovered before the window
+ * closes.
+ * A pulled reading is not a collect delay sample: it is late by the pull.
+ *
+ * @param ptr Round.
+ */
+static void pull_timer_cb(void *ptr);
 
 /**
  * @brief Actuation logic.
@@ -78,220 +201,452 @@ static void collect_timer_cb(void *ignored);
  * collected.
  * Checks for the steady state conditions and assigns commands to all
  * sensor(s)/actuator(s) that are violating them.
+ * Linear in the number of sensors: the commands are computed in closed form
+ * instead of iterating the checks to a fixpoint.
+ *
+ * @param round Round.
  */
-static void actuation_logic(void);
+static void actuation_logic(struct round_t *round);
+
+/**
+ * @brief Reset the reading of a sensor (RESET command).
+ * The value is kept: the min of the round is over the values as read, so that
+ * an early RESET does not change the commands of the other sensors. The
+ * commanded value is 0.
+ *
+ * @param slot Sensor slot.
+ * @param sensor_reading Sensor reading.
+ */
+static void actuation_reset(uint8_t slot,
+                            struct sensor_reading_t *sensor_reading);
+
+/**
+ * @brief Log the actuation command of a sensor.
+ *
+ * @param slot Sensor slot.
+ * @param sensor_reading Sensor reading.
+ */
+static void actuation_log(uint8_t slot,
+                          const struct sensor_reading_t *sensor_reading);
 
 /**
  * @brief Actuation commands.
- * Send command to sensor(s)/actuator(s) that needs actuation.
+ * Bundle the command of sensor(s)/actuator(s) that needs actuation, up to
+ * ETC_COMMAND_BUNDLE_MAX_SIZE, the others are sent in unicast.
+ *
+ * @param round Round.
+ * @param bundle Bundled commands (ETC_COMMAND_BUNDLE_MAX_SIZE entries).
+ * @return Number of bundled commands.
+ */
+static uint8_t actuation_commands(struct round_t *round,
+                                  struct command_entry_t *bundle);
+
+/**
+ * @brief Early actuation.
+ * Sends the commands that no further reading can change: a RESET for a
+ * threshold out of range or for a value that exceeds the maximum difference
+ * from the min so far (the min can only decrease), and from 0 once a sensor is
+ * reset. The other commands wait for the collect timer.
+ *
+ * @param round Round.
+ */
+static void actuation_early(struct round_t *round);
+
+/**
+ * @brief Send the command of a sensor and cache the commanded reading.
+ *
+ * @param round Round.
+ * @param slot Sensor slot.
+ * @param bundle Bundled commands (NULL to send in unicast).
+ * @param num_bundled Number of bundled commands.
+ */
+static void actuation_send(struct round_t *round, uint8_t slot,
+                           struct command_entry_t *bundle,
+                           uint8_t *num_bundled);
+
+/**
+ * @brief Request the readings of the round that are stale or relevant.
+ * A sensor must reply if it is the event source, if the error bound of its
+ * cached reading exceeds CONTROLLER_READING_MAX_ERROR or if within the error
+ * bound it could need a command.
+ * The other sensors use their cached reading.
+ *
+ * @param round Round.
+ */
+static void collect_request(struct round_t *round);
+
+/**
+ * @brief Return the error bound of the cached reading of a sensor.
+ * The value grows by less than SENSOR_UPDATE_INCREMENT_MAX per interval.
+ *
+ * @param slot Sensor slot.
+ * @return Maximum value increase since the reading, UINT32_MAX if unknown.
  */
-static void actuation_commands(void);
+static uint32_t cache_error(uint8_t slot);
+
+/**
+ * @brief Update the collect delay estimate of a sensor.
+ *
+ * @param slot Sensor slot.
+ * @param delay Collect delay sample.
+ */
+static void delay_update(uint8_t slot, clock_time_t delay);
+
+/**
+ * @brief Exponentially weighted moving average of collect delays.
+ *
+ * @param average Current average.
+ * @param sample New sample.
+ * @return New average.
+ */
+static clock_time_t ewma(clock_time_t average, clock_time_t sample);
+
+/**
+ * @brief Set the collect timer of the round to the time the missing readings
+ * are overdue.
+ * The missing sensor with the latest bound (mean delay plus
+ * CONTROLLER_COLLECT_DELAY_DEVIATIONS mean deviations, at least
+ * CONTROLLER_COLLECT_DELAY_MARGIN) decides, a sensor without estimate waits
+ * CONTROLLER_COLLECT_WAIT.
+ * The pull timer is set at CONTROLLER_PULL_AT percent of the window.
+ *
+ * @param round Round.
+ */
+static void collect_timer_update(struct round_t *round);
+
+/**
+ * @brief Check if a sensor is suspected dead.
+ *
+ * @param slot Sensor slot.
+ * @return true Suspected dead.
+ * @return false Alive.
+ */
+static bool sensor_suspected(uint8_t slot);
+
+/**
+ * @brief A message of a sensor has been received: the sensor is alive.
+ * Also called when the round of the message is no longer in flight, so that a
+ * suspected dead sensor rejoins as soon as it is heard again.
+ *
+ * @param slot Sensor slot.
+ */
+static void sensor_heard(uint8_t slot);
+
+/**
+ * @brief Update the liveness of the sensors at the end of the round.
+ * A sensor whose requested reading is missing misses the round.
+ *
+ * @param round Round.
+ */
+static void liveness_update(const struct round_t *round);
+
+/**
+ * @brief Check if the readings of all the sensors not suspected dead have
+ * been collected.
+ *
+ * @param round Round.
+ * @return true Complete.
+ * @return false Readings missing.
+ */
+static bool round_complete(const struct round_t *round);
+
+/**
+ * @brief Find the round of an event.
+ *
+ * @param event_seqn Event sequence number.
+ * @param event_source Slot of the sensor that generated the event.
+ * @return Round or NULL if not in flight.
+ */
+static struct round_t *round_find(uint16_t event_seqn, uint8_t event_source);
+
+/**
+ * @brief Start the round of an event in a free round.
+ * If all rounds are in flight a round with lower priority is cut short:
+ * actuation runs on the readings collected so far.
+ *
+ * @param event_seqn Event sequence number.
+ * @param event_source Slot of the sensor that generated the event.
+ * @param priority Event priority.
+ * @return Round or NULL if ETC_MAX_ROUNDS rounds are in flight.
+ */
+static struct round_t *round_new(uint16_t event_seqn, uint8_t event_source,
+                                 enum event_priority_t priority);
 
 /**
  * @brief Callbacks.
  */
 static const struct etc_callbacks_t cb = {
-    .event_cb = event_cb, .collect_cb = collect_cb, .command_cb = NULL};
+    .event_cb = event_cb,
+    .collect_cb = collect_cb,
+    .unchanged_cb = unchanged_cb,
+    .command_cb = NULL};
 
 void controller_init(void) {
   size_t i;
 
-  /* Initialize sensor readings structure */
-  for (i = 0; i < NUM_SENSORS; ++i) {
-    linkaddr_copy(&sensor_readings[i].address, &SENSORS[i]);
-    sensor_readings[i].seqn = 0;
-    sensor_readings[i].value = 0;
-    sensor_readings[i].threshold = CONTROLLER_MAX_DIFF;
-    sensor_readings[i].reading_available = false;
-    sensor_readings[i].command = COMMAND_TYPE_NONE;
+  /* Initialize rounds structure */
+  for (i = 0; i < ETC_MAX_ROUNDS; ++i) {
+    rounds[i].event_seqn = 0;
+    rounds[i].event_source = REGISTRY_SLOT_NONE;
+    rounds[i].num_sensor_readings = 0;
+  }
+  for (i = 0; i < MAX_SENSORS; ++i) {
+    event_seqns[i] = 0;
+    sensor_cache[i].available = false;
+    sensor_delays[i].available = false;
+    sensor_missed[i] = 0;
   }
-  num_sensor_readings = 0;
 
   /* Open ETC connection */
   etc_open(CONNECTION_CHANNEL, &cb);
 }
 
-static void event_cb(uint16_t event_seqn, const linkaddr_t *event_source) {
-  const struct etc_event_t *event = etc_get_current_event();
-  struct sensor_reading_t *sensor_reading;
-  size_t i;
-
-  /* Ignore if collect timer has not expired */
-  if (!ctimer_expired(&collect_timer)) {
-    LOG_WARN(
-        "Discarding event with source %02x:%02x because collect timer has not "
-        "expired",
-        event_source->u8[0], event_source->u8[1]);
-    return;
-  }
-
-  /* Find sensor reading */
-  for (i = 0; i < NUM_SENSORS; ++i) {
-    sensor_reading = &sensor_readings[i];
-    if (linkaddr_cmp(event_source, &sensor_reading->address)) break; /* Found */
-  }
+static void event_cb(uint16_t event_seqn, uint8_t event_source,
+                     enum event_priority_t priority) {
+  const linkaddr_t *source_address = registry_get(event_source);
+  struct round_t *round;
 
   /* Check if event source is known */
-  if (i >= NUM_SENSORS) {
-    LOG_WARN("Event has unknown source: %02x:%02x", event_source->u8[0],
-             event_source->u8[1]);
+  if (event_source >= registry_length()) {
+    LOG_WARN("Event has unknown source: %u", event_source);
     return;
   }
 
+  /* Heard: alive (even if not handled) */
+  sensor_heard(event_source);
+
   /* Check if event is old */
-  if (event_seqn != 0 && event_seqn <= sensor_reading->seqn) {
+  if (event_seqn != 0 && event_seqn <= event_seqns[event_source]) {
     LOG_WARN(
         "Discarding event with source %02x:%02x because last reading of seqn "
         "%u >= %u received",
-        event_source->u8[0], event_source->u8[1], sensor_reading->seqn,
-        event_seqn);
+        source_address->u8[0], source_address->u8[1],
+        event_seqns[event_source], event_seqn);
     return;
   }
 
-  /* Save event seqn */
-  sensor_reading->seqn = event_seqn;
-
-  /* Reset sensor readings */
-  num_sensor_readings = 0;
-  for (i = 0; i < NUM_SENSORS; ++i) {
-    sensor_readings[i].reading_available = false;
-    sensor_readings[i].command = COMMAND_TYPE_NONE;
+  /* Start round */
+  round = round_new(event_seqn, event_source, priority);
+  if (round == NULL) {
+    LOG_WARN(
+        "Discarding event with source %02x:%02x because %u rounds are in "
+        "flight",
+        source_address->u8[0], source_address->u8[1], ETC_MAX_ROUNDS);
+    return;
   }
 
+  /* Save event seqn */
+  event_seqns[event_source] = event_seqn;
+
   LOG_INFO(
       "Handling event: "
-      "{ seqn: %u, source: %02x:%02x}",
-      event->seqn, event->source.u8[0], event->source.u8[1]);
+      "{ seqn: %u, source: %02x:%02x, priority: %d }",
+      event_seqn, source_address->u8[0], source_address->u8[1], priority);
 #ifdef STATS
-  printf("EVENT [%02x:%02x, %u]\n", event->source.u8[0], event->source.u8[1],
-         event->seqn);
+  printf("EVENT [%02x:%02x, %u]\n", source_address->u8[0],
+         source_address->u8[1], event_seqn);
 #endif
 
+  /* Request stale or relevant readings */
+  collect_request(round);
+
   /* Schedule sensor readings analysis */
-  ctimer_set(&collect_timer, CONTROLLER_COLLECT_WAIT, collect_timer_cb, NULL);
+  collect_timer_update(round);
 }
 
-static void collect_cb(uint16_t event_seqn, const linkaddr_t *event_source,
-                       const linkaddr_t *sender, uint32_t value,
-                       uint32_t threshold) {
-  const struct etc_event_t *event = etc_get_current_event();
-  struct sensor_reading_t *sensor_reading = NULL;
-  struct sensor_reading_t *event_sensor_reading = NULL;
-  size_t i;
-
-  if (num_sensor_readings >= NUM_SENSORS) {
-    LOG_WARN(
-        "Ignoring collect event because reached maximum readings "
-        "(Duplicate or Old): { seqn: %u, source: %02x:%02x }",
-        event_seqn, event_source->u8[0], event_source->u8[1]);
-    return;
-  }
+static void collect_cb(uint16_t event_seqn, uint8_t event_source,
+                       uint8_t sender, uint32_t value, uint32_t threshold) {
+  collect_reading(event_seqn, event_source, sender, value, threshold, false);
+}
 
-  /* Find sensor reading(s) */
-  for (i = 0; i < NUM_SENSORS; ++i) {
-    /* Sensor reading */
-    if (sensor_reading == NULL)
-      sensor_reading = (linkaddr_cmp(sender, &sensor_readings[i].address)
-                            ? &sensor_readings[i]
-                            : NULL);
-    /* Event sensor reading */
-    if (event_sensor_reading == NULL)
-      event_sensor_reading =
-          (linkaddr_cmp(event_source, &sensor_readings[i].address)
-               ? &sensor_readings[i]
-               : NULL);
-    /* Found */
-    if (sensor_reading != NULL && event_sensor_reading != NULL) break;
-  }
+static void collect_reading(uint16_t event_seqn, uint8_t event_source,
+                            uint8_t sender, uint32_t value, uint32_t threshold,
+                            bool unchanged) {
+  const linkaddr_t *source_address = registry_get(event_source);
+  const linkaddr_t *sender_address = registry_get(sender);
+  struct round_t *round;
+  struct sensor_reading_t *sensor_reading;
 
   /* Check if sender is known */
-  if (sensor_reading == NULL) {
-    LOG_WARN("Collect has unknown sender: %02x:%02x", sender->u8[0],
-             sender->u8[1]);
-    return;
-  }
-  /* Check if event source is known */
-  if (event_sensor_reading == NULL) {
-    LOG_WARN("Collect has unknown event source: %02x:%02x", event_source->u8[0],
-             event_source->u8[1]);
+  if (sender >= registry_length()) {
+    LOG_WARN("Collect has unknown sender: %u", sender);
     return;
   }
 
+  /* Heard: alive (even if late) */
+  sensor_heard(sender);
+
+  /* Find round */
+  round = round_find(event_seqn, event_source);
+
   /* Check if collect's event is handled */
-  if (event_seqn != event->seqn ||
-      !linkaddr_cmp(event_source, &event->source)) {
+  if (round == NULL) {
     LOG_WARN(
-        "Collect event { seqn: %u, source: %02x:%02x } is not currently "
-        "handled event { seqn: %u, source: %02x:%02x }",
-        event_seqn, event_source->u8[0], event_source->u8[1], event->seqn,
-        event->source.u8[0], event->source.u8[1]);
+        "Collect event { seqn: %u, source: %02x:%02x } is not handled "
+        "(Duplicate or Old)",
+        event_seqn, source_address->u8[0], source_address->u8[1]);
     return;
   }
-  /* Check if collect's event is saved */
-  if (event_seqn != event_sensor_reading->seqn ||
-      !linkaddr_cmp(event_source, &event_sensor_reading->address)) {
-    LOG_WARN(
-        "Collect event { seqn: %u, source: %02x:%02x } "
-        "is not saved { seqn: %u, source: %02x:%02x }",
-        event_seqn, event_source->u8[0], event_source->u8[1],
-        event_sensor_reading->seqn, event_sensor_reading->address.u8[0],
-        event_sensor_reading->address.u8[1]);
+  sensor_reading = &round->sensor_readings[sender];
+
+  /* Check if duplicate */
+  if (sensor_reading->reading_available && !sensor_reading->reading_cached) {
+    LOG_WARN("Collect from sensor %02x:%02x already received",
+             sender_address->u8[0], sender_address->u8[1]);
     return;
   }
 
-  /* Check if duplicate */
-  if (sensor_reading->reading_available ||
-      (value == sensor_reading->value &&
-       threshold == sensor_reading->threshold)) {
-    LOG_WARN("Collect from sensor %02x:%02x already received", sender->u8[0],
-             sender->u8[1]);
+  /* Check if already reset (early, on the cached reading) */
+  if (sensor_reading->command_sent) {
+    LOG_WARN("Collect from sensor %02x:%02x already reset",
+             sender_address->u8[0], sender_address->u8[1]);
     return;
   }
 
-  /* Check if collect's event is old done in event_cb and checked thanks to
-   * event-sensor_reading */
+  /* Increase sensor readings counter (cached reading already counted) */
+  if (!sensor_reading->reading_available) round->num_sensor_readings += 1;
 
   /* Save reading */
   sensor_reading->value = value;
   sensor_reading->threshold = threshold;
   sensor_reading->reading_available = true;
+  sensor_reading->reading_cached = false;
   sensor_reading->command = COMMAND_TYPE_NONE;
 
-  /* Increase sensor readings counter */
-  num_sensor_readings += 1;
+  /* Cache reading (an unchanged one is already cached, keep its time) */
+  if (!unchanged) {
+    sensor_cache[sender].value = value;
+    sensor_cache[sender].threshold = threshold;
+    sensor_cache[sender].time = clock_time();
+    sensor_cache[sender].available = true;
+  }
+
+  /* Learn collect delay (a pulled reading is not a sample) */
+  if (!sensor_reading->pulled)
+    delay_update(sender, clock_time() - round->start);
 
   LOG_INFO(
       "Collect from sensor %02x:%02x of event { seqn: %u, source: %02x:%02x }: "
       "{ value: %lu, threshold: %lu }",
-      sender->u8[0], sender->u8[1], event->seqn, event->source.u8[0],
-      event->source.u8[1], value, threshold);
+      sender_address->u8[0], sender_address->u8[1], event_seqn,
+      source_address->u8[0], source_address->u8[1], value, threshold);
 #ifdef STATS
-  printf("COLLECT [%02x:%02x, %u] %02x:%02x (%lu, %lu)\n", event->source.u8[0],
-         event->source.u8[1], event->seqn, sender->u8[0], sender->u8[1], value,
-         threshold);
+  printf("COLLECT [%02x:%02x, %u] %02x:%02x (%lu, %lu)\n",
+         source_address->u8[0], source_address->u8[1], event_seqn,
+         sender_address->u8[0], sender_address->u8[1], value, threshold);
 #endif
 
-  if (num_sensor_readings >= NUM_SENSORS) {
+  if (!round_complete(round)) {
+    /* Send final commands now */
+    actuation_early(round);
+    /* Close the window when the missing readings are overdue */
+    collect_timer_update(round);
+  } else {
     /* Stop collect timer */
-    ctimer_stop(&collect_timer);
+    ctimer_stop(&round->collect_timer);
     /* Trigger collect timer manually */
-    collect_timer_cb(NULL);
+    collect_timer_cb(round);
   }
 }
 
-static void collect_timer_cb(void *ignored) {
+static void unchanged_cb(uint16_t event_seqn, uint8_t event_source,
+                         uint8_t sender) {
+  /* Check if sender is known */
+  if (sender >= registry_length()) {
+    LOG_WARN("Unchanged collect has unknown sender: %u", sender);
+    return;
+  }
+
+  /* Heard: alive (even if late) */
+  sensor_heard(sender);
+
+  /* Check cached reading (e.g. lost on command send failure) */
+  if (!sensor_cache[sender].available) {
+    LOG_WARN("Unchanged collect from sensor %u without cached reading",
+             sender);
+    return;
+  }
+
+  collect_reading(event_seqn, event_source, sender, sensor_cache[sender].value,
+                  sensor_cache[sender].threshold, true);
+}
+
+static void collect_timer_cb(void *ptr) {
+  struct round_t *round = (struct round_t *)ptr;
+  uint8_t collected[CONNECTION_SUBTREE_SIZE];
+  struct command_entry_t bundle[ETC_COMMAND_BUNDLE_MAX_SIZE];
+  uint8_t num_bundled;
+  const struct sensor_reading_t *sensor_reading;
+  size_t i;
+
   /* All data collected or timer expired */
+  ctimer_stop(&round->pull_timer);
+
+  /* Learn liveness */
+  if (!round->cut_short) liveness_update(round);
 
   /* Actuate */
-  actuation_logic();
-  /* Send command(s) */
-  actuation_commands();
+  actuation_logic(round);
+  /* Bundle command(s) */
+  num_bundled = actuation_commands(round, bundle);
+
+  /* Received readings */
+  memset(collected, 0, sizeof(collected));
+  for (i = 0; i < registry_length(); ++i) {
+    sensor_reading = &round->sensor_readings[i];
+    if (sensor_reading->reading_available && !sensor_reading->reading_cached)
+      collected[i / 8] |= 1 << (i % 8);
+  }
+
+  /* Release suppression and send bundled command(s) */
+  if (!etc_round_end(round->event_seqn, round->event_source, collected,
+                     bundle, num_bundled)) {
+    /* Unknown outcome */
+    for (i = 0; i < num_bundled; ++i)
+      sensor_cache[bundle[i].receiver].available = false;
+  }
+
+  /* Free round */
+  round->event_source = REGISTRY_SLOT_NONE;
+}
+
+static void pull_timer_cb(void *ptr) {
+  struct round_t *round = (struct round_t *)ptr;
+  const linkaddr_t *address;
+  size_t num_pulled = 0;
+  size_t i;
+
+  round->pulled = true;
+
+  for (i = 0; i < registry_length(); ++i) {
+    /* Not pulling a suspected dead sensor */
+    if (round->sensor_readings[i].reading_available || sensor_suspected(i))
+      continue;
+
+    if (!etc_command(round->event_seqn, round->event_source, i,
+                     COMMAND_TYPE_PULL, 0)) {
+      address = registry_get(i);
+      LOG_ERROR("Error pulling reading of sensor %02x:%02x", address->u8[0],
+                address->u8[1]);
+      continue;
+    }
+    round->sensor_readings[i].pulled = true;
+    num_pulled += 1;
+  }
+
+  LOG_INFO("Pulled %u missing readings of event { seqn: %u, source: %u }",
+           num_pulled, round->event_seqn, round->event_source);
 }
 
-static void actuation_logic(void) {
-  size_t i, j;
+static void actuation_logic(struct round_t *round) {
+  struct sensor_reading_t *sensor_readings = round->sensor_readings;
+  const uint8_t num_sensor_readings = round->num_sensor_readings;
+  struct sensor_reading_t *sensor_reading;
+  const linkaddr_t *address;
+  size_t i;
   uint8_t num_readings = 0;
-  bool restart_check = false;
+  uint32_t value_min = UINT32_MAX;
+  bool reset = false;
 
   /* Check at least 1 sensor data collected */
   if (num_sensor_readings < 1) {
@@ -303,23 +658,21 @@ static void actuation_logic(void) {
   }
 
   LOG_INFO("Collected data from %u/%u sensors", num_sensor_readings,
-           NUM_SENSORS);
+           registry_length());
 
   /* Print sensor readings */
-  for (i = 0; i < NUM_SENSORS; ++i) {
+  for (i = 0; i < registry_length(); ++i) {
+    address = registry_get(i);
     if (!sensor_readings[i].reading_available) {
-      LOG_WARN("Sensor %02x:%02x: { }", sensor_readings[i].address.u8[0],
-               sensor_readings[i].address.u8[1]);
+      LOG_WARN("Sensor %02x:%02x: { }", address->u8[0], address->u8[1]);
 #ifdef STATS
-      printf("Controller: Missing %02x:%02x data\n",
-             sensor_readings[i].address.u8[0],
-             sensor_readings[i].address.u8[1]);
+      printf("Controller: Missing %02x:%02x data\n", address->u8[0],
+             address->u8[1]);
 #endif
     } else {
       num_readings += 1;
       LOG_INFO("Sensor %02x:%02x: { seqn: %u, value: %lu, threshold: %lu } %s",
-               sensor_readings[i].address.u8[0],
-               sensor_readings[i].address.u8[1], sensor_readings[i].seqn,
+               address->u8[0], address->u8[1], event_seqns[i],
                sensor_readings[i].value, sensor_readings[i].threshold,
                sensor_readings[i].value >= sensor_readings[i].threshold ? "!!!"
                                                                         : "");
@@ -334,116 +687,423 @@ static void actuation_logic(void) {
     LOG_ERROR("!!!!!!!!!!!!!!!!");
   }
 
-  /* Search for nodes in need of actuation */
-  while (true) {
-    restart_check = false;
-    uint32_t value_min = UINT32_MAX;
+  /* Find min */
+  for (i = 0; i < registry_length(); ++i) {
+    if (sensor_readings[i].reading_available)
+      value_min = MIN(value_min, sensor_readings[i].value);
+  }
 
-    /* Find min */
-    for (i = 0; i < NUM_SENSORS; ++i) {
-      if (sensor_readings[i].reading_available) {
-        value_min = MIN(value_min, sensor_readings[i].value);
-      }
+  /* Check for any violation of the steady state condition, and for sensors
+   * with outdated thresholds.
+   * Single pass: a THRESHOLD command does not change the min, so the new
+   * threshold is the first multiple of the min above the value, a RESET
+   * command sets the min to 0 (see below) */
+  for (i = 0; i < registry_length(); ++i) {
+    sensor_reading = &sensor_readings[i];
+    if (!sensor_reading->reading_available) continue;
+
+    /* Already reset (early) */
+    if (sensor_reading->command == COMMAND_TYPE_RESET) {
+      reset = true;
+      continue;
+    }
+
+    /* Case 2: THRESHOLD (only if not case 1) */
+    if (sensor_reading->value < value_min + CONTROLLER_MAX_DIFF &&
+        sensor_reading->threshold <= CONTROLLER_MAX_THRESHOLD &&
+        sensor_reading->value > sensor_reading->threshold && value_min > 0) {
+      sensor_reading->command = COMMAND_TYPE_THRESHOLD;
+      sensor_reading->threshold +=
+          (sensor_reading->value - sensor_reading->threshold + value_min - 1) /
+          value_min * value_min;
+      actuation_log(i, sensor_reading);
     }
 
-    /* Check for any violation of the steady state condition, and for sensors
-     * with outdated thresholds */
-    for (i = 0; i < NUM_SENSORS; ++i) {
-      for (j = 0; j < NUM_SENSORS; ++j) {
-        if (!sensor_readings[i].reading_available) continue;
-
-        /* Check actuation command needed, if any:
-         * case 1) The maximum difference is being exceeded
-         * case 2) The current (local) threshold of a node is being exceeded
-         */
-        if (sensor_readings[j].reading_available &&
-            (sensor_readings[i].value >=
-                 sensor_readings[j].value + CONTROLLER_MAX_DIFF ||
-             sensor_readings[i].threshold > CONTROLLER_MAX_THRESHOLD)) {
-          /* Case 1: RESET */
-          sensor_readings[i].command = COMMAND_TYPE_RESET;
-          sensor_readings[i].value = 0;
-          sensor_readings[i].threshold = CONTROLLER_MAX_DIFF;
-
-          LOG_DEBUG(
-              "Actuation logic command RESET for sensor %02x:%02x: "
-              "{ value: %lu, threshold: %lu }",
-              sensor_readings[i].address.u8[0],
-              sensor_readings[i].address.u8[1], sensor_readings[i].value,
-              sensor_readings[i].threshold);
+    /* Check actuation command needed, if any:
+     * case 1) The maximum difference is being exceeded, or the threshold
+     * (possibly raised) is out of range
+     */
+    if (sensor_reading->value >= value_min + CONTROLLER_MAX_DIFF ||
+        sensor_reading->threshold > CONTROLLER_MAX_THRESHOLD) {
+      actuation_reset(i, sensor_reading);
+      reset = true;
+    }
+  }
+
+  /* Stop if no value changed */
+  if (!reset) return;
+
+  /* A reset value is the new min: reset the values that exceed the maximum
+   * difference from 0 */
+  for (i = 0; i < registry_length(); ++i) {
+    sensor_reading = &sensor_readings[i];
+    if (!sensor_reading->reading_available ||
+        sensor_reading->command == COMMAND_TYPE_RESET)
+      continue;
+
+    if (sensor_reading->value >= CONTROLLER_MAX_DIFF)
+      actuation_reset(i, sensor_reading);
+  }
+}
+
+static void actuation_reset(uint8_t slot,
+                            struct sensor_reading_t *sensor_reading) {
+  /* Case 1: RESET */
+  sensor_reading->command = COMMAND_TYPE_RESET;
+  sensor_reading->threshold = CONTROLLER_MAX_DIFF;
+  actuation_log(slot, sensor_reading);
+}
+
+static void actuation_log(uint8_t slot,
+                          const struct sensor_reading_t *sensor_reading) {
+  const linkaddr_t *address = registry_get(slot);
+
+  if (sensor_reading->command == COMMAND_TYPE_RESET) {
+    LOG_DEBUG(
+        "Actuation logic command RESET for sensor %02x:%02x: "
+        "{ value: %lu, threshold: %lu }",
+        address->u8[0], address->u8[1], 0UL, sensor_reading->threshold);
 #ifdef STATS
-          printf("Controller: Reset %02x:%02x (%lu, %lu)\n",
-                 sensor_readings[i].address.u8[0],
-                 sensor_readings[i].address.u8[1], sensor_readings[i].value,
-                 sensor_readings[i].threshold);
+    printf("Controller: Reset %02x:%02x (%lu, %lu)\n", address->u8[0],
+           address->u8[1], 0UL, sensor_reading->threshold);
 #endif
-
-          /* Value changed */
-          restart_check = true;
-        } else if (sensor_readings[i].value > sensor_readings[i].threshold) {
-          /* Case 2: THRESHOLD */
-          sensor_readings[i].command = COMMAND_TYPE_THRESHOLD;
-          sensor_readings[i].threshold += value_min;
-
-          LOG_DEBUG(
-              "Actuation logic command THRESHOLD for sensor %02x:%02x: "
-              "{ value: %lu, threshold: %lu }",
-              sensor_readings[i].address.u8[0],
-              sensor_readings[i].address.u8[1], sensor_readings[i].value,
-              sensor_readings[i].threshold);
+  } else {
+    LOG_DEBUG(
+        "Actuation logic command THRESHOLD for sensor %02x:%02x: "
+        "{ value: %lu, threshold: %lu }",
+        address->u8[0], address->u8[1], sensor_reading->value,
+        sensor_reading->threshold);
 #ifdef STATS
-          printf("Controller: Update threshold %02x:%02x (%lu, %lu)\n",
-                 sensor_readings[i].address.u8[0],
-                 sensor_readings[i].address.u8[1], sensor_readings[i].value,
-                 sensor_readings[i].threshold);
+    printf("Controller: Update threshold %02x:%02x (%lu, %lu)\n",
+           address->u8[0], address->u8[1], sensor_reading->value,
+           sensor_reading->threshold);
 #endif
+  }
+}
 
-          /* Value changed */
-          restart_check = true;
-        }
-      }
-    }
+static uint8_t actuation_commands(struct round_t *round,
+                                  struct command_entry_t *bundle) {
+  uint8_t num_bundled = 0;
+  size_t i;
+
+  for (i = 0; i < registry_length(); ++i) {
+    /* Ignore if no command or already sent */
+    if (round->sensor_readings[i].command == COMMAND_TYPE_NONE ||
+        round->sensor_readings[i].command_sent)
+      continue;
 
-    /* Stop if no value changed */
-    if (!restart_check) break;
+    actuation_send(round, i, bundle, &num_bundled);
   }
+
+  return num_bundled;
 }
 
-static void actuation_commands(void) {
+static void actuation_early(struct round_t *round) {
+  struct sensor_reading_t *sensor_reading;
+  uint32_t value_min = UINT32_MAX;
+  bool restart;
   size_t i;
-  const struct etc_event_t *event = etc_get_current_event();
-  struct sensor_reading_t *sensor_reading = NULL;
 
-  for (i = 0; i < NUM_SENSORS; ++i) {
-    sensor_reading = &sensor_readings[i];
+  /* Min so far: the final min can only be lower, a reset value is 0 */
+  for (i = 0; i < registry_length(); ++i) {
+    sensor_reading = &round->sensor_readings[i];
+    if (!sensor_reading->reading_available) continue;
+    value_min = sensor_reading->command == COMMAND_TYPE_RESET
+                    ? 0
+                    : MIN(value_min, sensor_reading->value);
+  }
 
-    /* Ignore if no command */
-    if (sensor_reading->command == COMMAND_TYPE_NONE) continue;
+  do {
+    restart = false;
 
-    LOG_INFO(
-        "Actuation command %d for sensor %02x:%02x on event "
-        "{ seqn: %u, source: %02x:%02x }",
-        sensor_reading->command, sensor_reading->address.u8[0],
-        sensor_reading->address.u8[1], event->seqn, event->source.u8[0],
-        event->source.u8[1]);
+    for (i = 0; i < registry_length(); ++i) {
+      sensor_reading = &round->sensor_readings[i];
+      if (!sensor_reading->reading_available ||
+          sensor_reading->command == COMMAND_TYPE_RESET)
+        continue;
+
+      /* RESET is final if the threshold is out of range or if the maximum
+       * difference from the min so far is exceeded */
+      if (sensor_reading->threshold <= CONTROLLER_MAX_THRESHOLD &&
+          sensor_reading->value < value_min + CONTROLLER_MAX_DIFF)
+        continue;
+
+      actuation_reset(i, sensor_reading);
+      actuation_send(round, i, NULL, NULL);
+
+      /* A reset value is the new min */
+      if (value_min > 0) {
+        value_min = 0;
+        restart = true;
+      }
+    }
+  } while (restart);
+}
+
+static void actuation_send(struct round_t *round, uint8_t slot,
+                           struct command_entry_t *bundle,
+                           uint8_t *num_bundled) {
+  const linkaddr_t *source_address = registry_get(round->event_source);
+  const linkaddr_t *address = registry_get(slot);
+  struct sensor_reading_t *sensor_reading = &round->sensor_readings[slot];
+
+  LOG_INFO(
+      "Actuation command %d for sensor %02x:%02x on event "
+      "{ seqn: %u, source: %02x:%02x }",
+      sensor_reading->command, address->u8[0], address->u8[1],
+      round->event_seqn, source_address->u8[0], source_address->u8[1]);
 #ifdef STATS
-    printf("COMMAND [%02x:%02x, %u] %02x:%02x\n", event->source.u8[0],
-           event->source.u8[1], event->seqn, sensor_readings[i].address.u8[0],
-           sensor_readings[i].address.u8[1]);
+  printf("COMMAND [%02x:%02x, %u] %02x:%02x\n", source_address->u8[0],
+         source_address->u8[1], round->event_seqn, address->u8[0],
+         address->u8[1]);
 #endif
 
-    /* Send command message via ETC */
-    if (!etc_command(&sensor_reading->address, sensor_reading->command,
-                     sensor_reading->threshold)) {
-      LOG_ERROR(
-          "Error sending ETC command %d for sensor %02x:%02x on event "
-          "{ seqn: %u, source: %02x:%02x }",
-          sensor_reading->command, sensor_reading->address.u8[0],
-          sensor_reading->address.u8[1], event->seqn, event->source.u8[0],
-          event->source.u8[1]);
+  sensor_reading->command_sent = true;
+
+  /* Bundle in round end message, or send command message via ETC */
+  if (bundle != NULL && *num_bundled < ETC_COMMAND_BUNDLE_MAX_SIZE) {
+    bundle[*num_bundled].receiver = slot;
+    bundle[*num_bundled].command = sensor_reading->command;
+    bundle[*num_bundled].threshold = sensor_reading->threshold;
+    *num_bundled += 1;
+  } else if (!etc_command(round->event_seqn, round->event_source, slot,
+                          sensor_reading->command,
+                          sensor_reading->threshold)) {
+    LOG_ERROR(
+        "Error sending ETC command %d for sensor %02x:%02x on event "
+        "{ seqn: %u, source: %02x:%02x }",
+        sensor_reading->command, address->u8[0], address->u8[1],
+        round->event_seqn, source_address->u8[0], source_address->u8[1]);
+    /* Unknown outcome */
+    sensor_cache[slot].available = false;
+    return;
+  }
+
+  /* Cache commanded reading */
+  if (sensor_reading->command == COMMAND_TYPE_RESET) {
+    sensor_cache[slot].time = clock_time();
+    sensor_cache[slot].value = 0;
+  } else {
+    sensor_cache[slot].value = sensor_reading->value;
+  }
+  sensor_cache[slot].threshold = sensor_reading->threshold;
+}
+
+static void collect_request(struct round_t *round) {
+  uint8_t sensors[CONNECTION_SUBTREE_SIZE];
+  struct sensor_reading_t *sensor_reading;
+  const struct sensor_cache_t *cache;
+  uint32_t value_min = UINT32_MAX;
+  uint32_t error;
+  size_t i;
+
+  /* Minimum known value */
+  for (i = 0; i < registry_length(); ++i) {
+    if (sensor_cache[i].available)
+      value_min = MIN(value_min, sensor_cache[i].value);
+  }
+
+  memset(sensors, 0, sizeof(sensors));
+  for (i = 0; i < registry_length(); ++i) {
+    cache = &sensor_cache[i];
+    error = cache_error(i);
+
+    /* Must reply if stale or relevant */
+    if (i == round->event_source || error > CONTROLLER_READING_MAX_ERROR ||
+        cache->value + error > cache->threshold ||
+        cache->threshold > CONTROLLER_MAX_THRESHOLD ||
+        cache->value + error >= value_min + CONTROLLER_MAX_DIFF) {
+      sensors[i / 8] |= 1 << (i % 8);
+      continue;
     }
+
+    /* Use cached reading */
+    sensor_reading = &round->sensor_readings[i];
+    sensor_reading->value = cache->value;
+    sensor_reading->threshold = cache->threshold;
+    sensor_reading->reading_available = true;
+    sensor_reading->reading_cached = true;
+    round->num_sensor_readings += 1;
+  }
+
+  LOG_INFO("Requesting %u/%u readings",
+           registry_length() - round->num_sensor_readings, registry_length());
+
+  /* Send collect request message via ETC */
+  if (!etc_collect_request(round->event_seqn, round->event_source, sensors))
+    LOG_ERROR("Error sending ETC collect request");
+}
+
+static uint32_t cache_error(uint8_t slot) {
+  const struct sensor_cache_t *cache = &sensor_cache[slot];
+  const clock_time_t age = clock_time() - cache->time;
+
+  if (!cache->available) return UINT32_MAX;
+
+  /* Intervals since the reading, the current one included */
+  return (uint32_t)(age / SENSOR_UPDATE_INTERVAL + 1) *
+         (SENSOR_UPDATE_INCREMENT_MAX - 1);
+}
+
+static void delay_update(uint8_t slot, clock_time_t delay) {
+  struct sensor_delay_t *sensor_delay = &sensor_delays[slot];
+  const clock_time_t deviation = delay > sensor_delay->mean
+                                     ? delay - sensor_delay->mean
+                                     : sensor_delay->mean - delay;
+
+  if (!sensor_delay->available) {
+    sensor_delay->mean = delay;
+    sensor_delay->deviation = delay / 2;
+    sensor_delay->available = true;
+    return;
+  }
+
+  sensor_delay->mean = ewma(sensor_delay->mean, delay);
+  sensor_delay->deviation = ewma(sensor_delay->deviation, deviation);
+}
+
+static clock_time_t ewma(clock_time_t average, clock_time_t sample) {
+  return ((uint32_t)average * CONTROLLER_COLLECT_DELAY_ALPHA +
+          (uint32_t)sample * (100 - CONTROLLER_COLLECT_DELAY_ALPHA)) /
+         100;
+}
+
+static void collect_timer_update(struct round_t *round) {
+  const clock_time_t elapsed = clock_time() - round->start;
+  const struct sensor_delay_t *sensor_delay;
+  clock_time_t wait = 0;
+  clock_time_t bound;
+  size_t i;
+
+  for (i = 0; i < registry_length() && wait < CONTROLLER_COLLECT_WAIT; ++i) {
+    /* Not waiting for a suspected dead sensor */
+    if (round->sensor_readings[i].reading_available || sensor_suspected(i))
+      continue;
+
+    /* Overdue bound */
+    sensor_delay = &sensor_delays[i];
+    if (!sensor_delay->available) {
+      bound = CONTROLLER_COLLECT_WAIT;
+    } else {
+      bound = sensor_delay->mean +
+              MAX(CONTROLLER_COLLECT_DELAY_DEVIATIONS * sensor_delay->deviation,
+                  CONTROLLER_COLLECT_DELAY_MARGIN);
+    }
+    wait = MAX(wait, MIN(bound, CONTROLLER_COLLECT_WAIT));
+  }
+
+  LOG_DEBUG("Collect window of event { seqn: %u, source: %u }: %u/%u ticks",
+            round->event_seqn, round->event_source, wait,
+            CONTROLLER_COLLECT_WAIT);
+
+  ctimer_set(&round->collect_timer, wait > elapsed ? wait - elapsed : 0,
+             collect_timer_cb, round);
+
+  /* Pull missing readings once */
+  if (round->pulled || wait == 0) {
+    ctimer_stop(&round->pull_timer);
+    return;
+  }
+  wait = (uint32_t)wait * CONTROLLER_PULL_AT / 100;
+  ctimer_set(&round->pull_timer, wait > elapsed ? wait - elapsed : 0,
+             pull_timer_cb, round);
+}
+
+static bool sensor_suspected(uint8_t slot) {
+  return sensor_missed[slot] >= CONTROLLER_LIVENESS_MAX_MISSED;
+}
+
+static void sensor_heard(uint8_t slot) {
+  const linkaddr_t *address;
+
+  if (sensor_suspected(slot)) {
+    address = registry_get(slot);
+    LOG_INFO("Sensor %02x:%02x is alive again", address->u8[0],
+             address->u8[1]);
+  }
+  sensor_missed[slot] = 0;
+}
+
+static void liveness_update(const struct round_t *round) {
+  const linkaddr_t *address;
+  size_t i;
+
+  for (i = 0; i < registry_length(); ++i) {
+    /* Received or not requested */
+    if (round->sensor_readings[i].reading_available) continue;
+
+    if (sensor_missed[i] < UINT8_MAX) sensor_missed[i] += 1;
+    if (sensor_missed[i] == CONTROLLER_LIVENESS_MAX_MISSED) {
+      address = registry_get(i);
+      LOG_WARN("Sensor %02x:%02x is suspected dead: %u rounds missed",
+               address->u8[0], address->u8[1], sensor_missed[i]);
+    }
+  }
+}
+
+static bool round_complete(const struct round_t *round) {
+  size_t i;
+
+  for (i = 0; i < registry_length(); ++i) {
+    if (!round->sensor_readings[i].reading_available && !sensor_suspected(i))
+      return false;
+  }
+
+  return true;
+}
+
+static struct round_t *round_find(uint16_t event_seqn, uint8_t event_source) {
+  size_t i;
+
+  for (i = 0; i < ETC_MAX_ROUNDS; ++i) {
+    if (rounds[i].event_source != REGISTRY_SLOT_NONE &&
+        rounds[i].event_seqn == event_seqn &&
+        rounds[i].event_source == event_source)
+      return &rounds[i];
+  }
+
+  return NULL;
+}
+
+static struct round_t *round_new(uint16_t event_seqn, uint8_t event_source,
+                                 enum event_priority_t priority) {
+  struct round_t *round = NULL;
+  size_t i;
+
+  /* Find free round */
+  for (i = 0; i < ETC_MAX_ROUNDS && round == NULL; ++i) {
+    if (rounds[i].event_source == REGISTRY_SLOT_NONE) round = &rounds[i];
+  }
+
+  /* Cut short a lower priority round */
+  for (i = 0; i < ETC_MAX_ROUNDS && round == NULL; ++i) {
+    if (rounds[i].priority >= priority) continue;
+    round = &rounds[i];
+    LOG_INFO("Cutting short round of event { seqn: %u, source: %u }",
+             round->event_seqn, round->event_source);
+    ctimer_stop(&round->collect_timer);
+    round->cut_short = true;
+    collect_timer_cb(round);
+  }
+  if (round == NULL) return NULL;
+
+  /* Reset sensor readings */
+  round->event_seqn = event_seqn;
+  round->event_source = event_source;
+  round->priority = priority;
+  round->start = clock_time();
+  round->cut_short = false;
+  round->pulled = false;
+  round->num_sensor_readings = 0;
+  for (i = 0; i < MAX_SENSORS; ++i) {
+    round->sensor_readings[i].value = 0;
+    round->sensor_readings[i].threshold = CONTROLLER_MAX_DIFF;
+    round->sensor_readings[i].reading_available = false;
+    round->sensor_readings[i].reading_cached = false;
+    round->sensor_readings[i].command = COMMAND_TYPE_NONE;
+    round->sensor_readings[i].command_sent = false;
+    round->sensor_readings[i].pulled = false;
   }
 
-  /* Set sensor readings full until a new event is received */
-  num_sensor_readings = NUM_SENSORS;
+  return round;
 }
@@ -12,6 +12,12 @@
  */
 static enum node_role_t node_role_cache = NODE_ROLE_UNKNOWN;
 
+/**
+ * @brief Sensor index cache.
+ * Index of the node in SENSORS (if Sensor/Actuator node).
+ */
+static size_t node_sensor_index_cache;
+
 /**
  * @brief String representation of node roles.
  */
@@ -30,14 +36,23 @@ enum node_role_t node_get_role(void) {
 
   /* Sensor/Actuator */
   for (i = 0; i < NUM_SENSORS; ++i) {
-    if (linkaddr_cmp(&SENSORS[i], &linkaddr_node_addr))
+    if (linkaddr_cmp(&SENSORS[i], &linkaddr_node_addr)) {
+      node_sensor_index_cache = i;
       return node_role_cache = NODE_ROLE_SENSOR_ACTUATOR;
+    }
   }
 
   /* Forwarder */
   return node_role_cache = NODE_ROLE_FORWARDER;
 }
 
+size_t node_get_sensor_index(void) {
+  /* Fill cache */
+  node_get_role();
+
+  return node_sensor_index_cache;
+}
+
 const char* node_get_role_name(void) {
   return node_role_strings[node_get_role()];
 }
@@ -1,6 +1,8 @@
 #ifndef _NODE_H_
 #define _NODE_H_
 
+#include <sys/types.h>
+
 /**
  * @brief Node roles.
  */
@@ -25,7 +27,9 @@ enum command_type_t {
   COMMAND_TYPE_RESET,
   /* Sensed value should not be modified, but the threshold should be increased.
    */
-  COMMAND_TYPE_THRESHOLD
+  COMMAND_TYPE_THRESHOLD,
+  /* Current reading should be sent again (answered by ETC). */
+  COMMAND_TYPE_PULL
 };
 
 /**
@@ -35,6 +39,15 @@ enum command_type_t {
  */
 enum node_role_t node_get_role(void);
 
+/**
+ * @brief Return the index of the Sensor/Actuator node in SENSORS.
+ * Only meaningful if the node role is NODE_ROLE_SENSOR_ACTUATOR.
+ * Note that the index is local: it is not the registry slot.
+ *
+ * @return Sensor index.
+ */
+size_t node_get_sensor_index(void);
+
 /**
  * @brief Return the role name of the node.
  *
@@ -1,6 +1,7 @@
 #include "sensor.h"
 
 #include "config/config.h"
+#include "connection/registry.h"
 #include "etc/etc.h"
 #include "logger/logger.h"
 #include "node/node.h"
@@ -26,8 +27,8 @@ static struct ctimer sensor_timer;
 static struct {
   /* Even sequence number */
   uint16_t event_seqn;
-  /* Event source */
-  linkaddr_t event_source;
+  /* Event source slot */
+  uint8_t event_source;
   /* Command type. */
   enum command_type_t type;
   /* Command threshold. */
@@ -46,18 +47,21 @@ static void sensor_timer_cb(void *ignored);
  * Notifies the sensor/actuator of a command from the controller.
  *
  * @param event_seqn Event sequence number.
- * @param event_source Event source node.
+ * @param event_source Event source node slot.
  * @param command Command type.
  * @param threshold New threshold.
  */
-static void command_cb(uint16_t event_seqn, const linkaddr_t *event_source,
+static void command_cb(uint16_t event_seqn, uint8_t event_source,
                        enum command_type_t command, uint32_t threshold);
 
 /**
  * @brief Callbacks.
  */
 static const struct etc_callbacks_t etc_cb = {
-    .event_cb = NULL, .collect_cb = NULL, .command_cb = command_cb};
+    .event_cb = NULL,
+    .collect_cb = NULL,
+    .unchanged_cb = NULL,
+    .command_cb = command_cb};
 
 void sensor_init(size_t index) {
   /* Data */
@@ -105,11 +109,11 @@ static void sensor_timer_cb(void *ignored) {
     } else {
       /* Success */
       const struct etc_event_t *event = etc_get_current_event();
-      LOG_INFO("Trigger { seqn: %u, source: %02x:%02x }", event->seqn,
-               event->source.u8[0], event->source.u8[1]);
+      LOG_INFO("Trigger { seqn: %u, source: %u, priority: %d }", event->seqn,
+               event->source, event->priority);
 #ifdef STATS
-      printf("TRIGGER [%02x:%02x, %u]\n", event->source.u8[0],
-             event->source.u8[1], event->seqn);
+      printf("TRIGGER [%02x:%02x, %u]\n", linkaddr_node_addr.u8[0],
+             linkaddr_node_addr.u8[1], event->seqn);
 #endif
     }
   }
@@ -118,30 +122,27 @@ static void sensor_timer_cb(void *ignored) {
   ctimer_set(&sensor_timer, SENSOR_UPDATE_INTERVAL, sensor_timer_cb, NULL);
 }
 
-static void command_cb(uint16_t event_seqn, const linkaddr_t *event_source,
+static void command_cb(uint16_t event_seqn, uint8_t event_source,
                        enum command_type_t command, uint32_t threshold) {
   /* Check if received duplicated command */
   if (last_command.event_seqn == event_seqn &&
-      linkaddr_cmp(&last_command.event_source, event_source) &&
+      last_command.event_source == event_source &&
       last_command.type == command && last_command.threshold == threshold) {
     LOG_WARN(
         "Duplicated command: "
-        "{ command: %d, threshold: %lu, "
-        "event_seqn: %u, event_source: %02x:%02x }: ",
-        command, threshold, event_seqn, event_source->u8[0],
-        event_source->u8[1]);
+        "{ command: %d, threshold: %lu, event_seqn: %u, event_source: %u }: ",
+        command, threshold, event_seqn, event_source);
     return;
   }
 
   LOG_INFO(
       "Command: "
-      "{ command: %d, threshold: %lu, "
-      "event_seqn: %u, event_source: %02x:%02x }: ",
-      command, threshold, event_seqn, event_source->u8[0], event_source->u8[1]);
+      "{ command: %d, threshold: %lu, event_seqn: %u, event_source: %u }: ",
+      command, threshold, event_seqn, event_source);
 #ifdef STATS
-  printf("ACTUATION [%02x:%02x, %u] %02x:%02x\n", event_source->u8[0],
-         event_source->u8[1], event_seqn, linkaddr_node_addr.u8[0],
-         linkaddr_node_addr.u8[1]);
+  printf("ACTUATION [%02x:%02x, %u] %02x:%02x\n",
+         registry_get(event_source)->u8[0], registry_get(event_source)->u8[1],
+         event_seqn, linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1]);
 #endif
 
   /* Actuate */
@@ -169,11 +170,15 @@ static void command_cb(uint16_t event_seqn, const linkaddr_t *event_source,
       LOG_INFO("Command NONE: Ignoring...");
       break;
     }
+    case COMMAND_TYPE_PULL: {
+      /* Answered by ETC */
+      break;
+    }
   }
 
   /* Update last command */
   last_command.event_seqn = event_seqn;
-  linkaddr_copy(&last_command.event_source, event_source);
+  last_command.event_source = event_source;
   last_command.type = command;
   last_command.threshold = threshold;
 }
@@ -0,0 +1,517 @@
+/*
+ * Host tests of the actuation logic of the controller (see
+ * src/node/controller/controller.c): the closed form against the fixpoint
+ * iteration it replaced, on random rounds, and a benchmark of both.
+ * Build and run with `make test`.
+ */
+#include <stdlib.h>
+#include <time.h>
+
+/* The actuation logic is static: test the translation unit itself */
+#include "node/controller/controller.c"
+
+/**
+ * @brief Check a condition, report the failure and count it.
+ */
+#define CHECK(cond)                                          \
+  do {                                                       \
+    if (!(cond)) {                                           \
+      printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      failures += 1;                                         \
+    }                                                        \
+  } while (0)
+
+/**
+ * @brief Number of random rounds.
+ */
+#define NUM_ROUNDS (100000)
+
+/**
+ * @brief Number of benchmark repetitions.
+ */
+#define NUM_REPETITIONS (100)
+
+/**
+ * @brief Iteration bound of the baseline fixpoint (see baseline_logic).
+ */
+#define BASELINE_MAX_ITERATIONS (1000)
+
+/**
+ * @brief Number of failed checks.
+ */
+static unsigned failures;
+
+/**
+ * @brief Number of registered sensors (registry_length).
+ */
+static size_t num_sensors;
+
+/**
+ * @brief Address of every sensor (registry_get).
+ */
+static const linkaddr_t address;
+
+/**
+ * @brief Command sent to the sensor in registry slot i, unicast or bundled
+ * (etc_command, etc_round_end).
+ */
+static struct command_entry_t sent[MAX_SENSORS];
+
+/**
+ * @brief Last event sequence number (event_cb).
+ */
+static uint16_t last_event_seqn;
+
+/**
+ * @brief Actuation logic before the closed form: iterate the checks of every
+ * pair of readings until no reading changes.
+ * The iteration does not terminate when the min is 0 while a reading is above
+ * its threshold (a THRESHOLD command adds the min, 0, forever): that is the
+ * case once a RESET zeroes the min in a round where the threshold of another
+ * reading is still being raised, or if a value is 0.
+ * The iterations are bounded by BASELINE_MAX_ITERATIONS.
+ *
+ * @param sensor_readings Sensor readings (num_sensors entries).
+ * @return true Fixpoint reached.
+ * @return false Iteration bound reached.
+ */
+static bool baseline_logic(struct sensor_reading_t *sensor_readings);
+
+/**
+ * @brief Closed form and baseline agree on random rounds.
+ * When the baseline does not terminate its state is not a result: the
+ * readings it leaves above their threshold are checked to have a threshold
+ * at least the value, or no command if the min is 0 (the closed form never
+ * raises a threshold by 0); the others are compared.
+ */
+static void test_equivalence(void);
+
+/**
+ * @brief An early RESET does not change the commands of the other sensors:
+ * a reading above its threshold still gets the THRESHOLD command of the min
+ * as read.
+ */
+static void test_early_reset(void);
+
+/**
+ * @brief A reading that replaces a cached reading already reset early is
+ * ignored: the RESET sent stays the command of the sensor.
+ */
+static void test_early_reset_replaced(void);
+
+/**
+ * @brief A pulled reading does not update the collect delay estimate of the
+ * sensor, a collected one does.
+ */
+static void test_pulled_delay(void);
+
+/**
+ * @brief Run a round of 3 sensors from the event to the round end and
+ * record the commands sent.
+ *
+ * @param value Sensor values.
+ * @param threshold Sensor thresholds.
+ * @param early Flag if the readings are received one at a time (early
+ * actuation), otherwise they are all in when the window closes.
+ */
+static void run_round(const uint32_t *value, const uint32_t *threshold,
+                      bool early);
+
+/**
+ * @brief Time the closed form and the baseline on a round that needs many
+ * iterations of the baseline.
+ */
+static void benchmark(void);
+
+/**
+ * @brief Fill a random round.
+ *
+ * @param sensor_readings Sensor readings (num_sensors entries).
+ * @return Number of available readings.
+ */
+static uint8_t random_round(struct sensor_reading_t *sensor_readings);
+
+/* --- --- */
+int main(void) {
+  srand(1);
+
+  test_equivalence();
+  test_early_reset();
+  test_early_reset_replaced();
+  test_pulled_delay();
+  benchmark();
+
+  if (failures != 0) {
+    printf("%u check(s) failed\n", failures);
+    return 1;
+  }
+  printf("All actuation checks passed\n");
+  return 0;
+}
+
+/* --- EQUIVALENCE --- */
+static void test_equivalence(void) {
+  struct round_t *round = &rounds[0];
+  struct sensor_reading_t baseline[MAX_SENSORS];
+  const struct sensor_reading_t *expected;
+  const struct sensor_reading_t *actual;
+  uint32_t value_min;
+  uint32_t baseline_min;
+  unsigned num_unterminated = 0;
+  unsigned r;
+  size_t i;
+
+  for (r = 0; r < NUM_ROUNDS; ++r) {
+    /* Mostly small rounds, a full one from time to time */
+    num_sensors = 1 + rand() % (r % 100 == 0 ? MAX_SENSORS : 8);
+    round->num_sensor_readings = random_round(round->sensor_readings);
+    memcpy(baseline, round->sensor_readings, sizeof(baseline));
+
+    value_min = UINT32_MAX;
+    for (i = 0; i < num_sensors; ++i) {
+      if (round->sensor_readings[i].reading_available)
+        value_min = MIN(value_min, round->sensor_readings[i].value);
+    }
+
+    actuation_logic(round);
+    if (!baseline_logic(baseline)) {
+      num_unterminated += 1;
+      /* Only a min of 0 stops the baseline from terminating */
+      baseline_min = UINT32_MAX;
+      for (i = 0; i < num_sensors; ++i) {
+        if (baseline[i].reading_available)
+          baseline_min = MIN(baseline_min, baseline[i].value);
+      }
+      CHECK(baseline_min == 0);
+    }
+
+    for (i = 0; i < num_sensors; ++i) {
+      expected = &baseline[i];
+      actual = &round->sensor_readings[i];
+
+      if (expected->reading_available &&
+          expected->command != COMMAND_TYPE_RESET &&
+          expected->value > expected->threshold) {
+        /* Left by an unterminated baseline */
+        CHECK(actual->command != COMMAND_TYPE_RESET);
+        CHECK(actual->threshold >= actual->value ||
+              (value_min == 0 && actual->command == COMMAND_TYPE_NONE));
+        continue;
+      }
+
+      CHECK(actual->command == expected->command);
+      CHECK(actual->threshold == expected->threshold);
+    }
+  }
+
+  printf("%u/%u random rounds equivalent (%u unterminated baseline)\n",
+         NUM_ROUNDS - num_unterminated, NUM_ROUNDS, num_unterminated);
+}
+
+/* --- EARLY RESET --- */
+static void test_early_reset(void) {
+  /* Sensor 1 exceeds the maximum difference from sensor 0 as soon as it is
+   * received, sensor 2 is above its threshold */
+  const uint32_t value[] = {1000, 20000, 5000};
+  const uint32_t threshold[] = {CONTROLLER_MAX_DIFF, CONTROLLER_MAX_DIFF,
+                                4000};
+  struct command_entry_t expected[MAX_SENSORS];
+  size_t i;
+
+  run_round(value, threshold, false);
+  memcpy(expected, sent, sizeof(sent));
+  CHECK(expected[0].command == COMMAND_TYPE_NONE);
+  CHECK(expected[1].command == COMMAND_TYPE_RESET);
+  CHECK(expected[1].threshold == CONTROLLER_MAX_DIFF);
+  CHECK(expected[2].command == COMMAND_TYPE_THRESHOLD);
+  CHECK(expected[2].threshold == 5000);
+
+  run_round(value, threshold, true);
+  for (i = 0; i < num_sensors; ++i) {
+    CHECK(sent[i].command == expected[i].command);
+    CHECK(sent[i].threshold == expected[i].threshold);
+    /* Commanded reading cached */
+    if (sent[i].command == COMMAND_TYPE_RESET)
+      CHECK(sensor_cache[i].value == 0);
+  }
+}
+
+static void test_early_reset_replaced(void) {
+  const struct sensor_reading_t *sensor_reading;
+  struct round_t *round;
+
+  num_sensors = 4;
+  controller_init();
+  memset(sent, 0, sizeof(sent));
+
+  /* Sensors 1 and 2 use their cached reading, sensor 3 is missing */
+  sensor_cache[1].value = 12000;
+  sensor_cache[1].threshold = 20000;
+  sensor_cache[1].time = clock_time();
+  sensor_cache[1].available = true;
+  sensor_cache[2] = sensor_cache[1];
+  sensor_cache[2].value = 11000;
+
+  last_event_seqn += 1;
+  event_cb(last_event_seqn, 0, EVENT_PRIORITY_NORMAL);
+  round = round_find(last_event_seqn, 0);
+  CHECK(round != NULL);
+  if (round == NULL) return;
+  CHECK(round->sensor_readings[1].reading_cached);
+
+  /* The event source lowers the min: sensors 1 and 2 are reset early */
+  collect_cb(last_event_seqn, 0, 0, 1000, CONTROLLER_MAX_DIFF);
+  CHECK(sent[1].command == COMMAND_TYPE_RESET);
+  CHECK(sent[2].command == COMMAND_TYPE_RESET);
+
+  /* The reading of sensor 1 arrives */
+  collect_cb(last_event_seqn, 0, 1, 500, CONTROLLER_MAX_DIFF);
+  sensor_reading = &round->sensor_readings[1];
+  CHECK(sensor_reading->command == COMMAND_TYPE_RESET);
+  CHECK(sensor_reading->value == 12000);
+  CHECK(sensor_reading->reading_cached);
+
+  /* Round complete: no other command for sensor 1 */
+  memset(sent, 0, sizeof(sent));
+  collect_cb(last_event_seqn, 0, 3, 2000, CONTROLLER_MAX_DIFF);
+  CHECK(round_find(last_event_seqn, 0) == NULL);
+  CHECK(sent[1].command == COMMAND_TYPE_NONE);
+}
+
+static void test_pulled_delay(void) {
+  struct round_t *round;
+
+  num_sensors = 3;
+  controller_init();
+  last_event_seqn += 1;
+  event_cb(last_event_seqn, 0, EVENT_PRIORITY_NORMAL);
+  round = round_find(last_event_seqn, 0);
+  CHECK(round != NULL);
+  if (round == NULL) return;
+
+  /* Sensor 0 collected, sensors 1 and 2 pulled */
+  collect_cb(last_event_seqn, 0, 0, 1000, CONTROLLER_MAX_DIFF);
+  pull_timer_cb(round);
+  collect_cb(last_event_seqn, 0, 1, 1000, CONTROLLER_MAX_DIFF);
+  CHECK(sensor_delays[0].available);
+  CHECK(!sensor_delays[1].available);
+
+  /* Next round: not pulled */
+  collect_cb(last_event_seqn, 0, 2, 1000, CONTROLLER_MAX_DIFF);
+  CHECK(round_find(last_event_seqn, 0) == NULL);
+  last_event_seqn += 1;
+  event_cb(last_event_seqn, 0, EVENT_PRIORITY_NORMAL);
+  collect_cb(last_event_seqn, 0, 1, 1000, CONTROLLER_MAX_DIFF);
+  CHECK(sensor_delays[1].available);
+}
+
+static void run_round(const uint32_t *value, const uint32_t *threshold,
+                      bool early) {
+  struct round_t *round;
+  size_t i;
+
+  num_sensors = 3;
+  controller_init();
+  memset(sent, 0, sizeof(sent));
+  last_event_seqn += 1;
+  event_cb(last_event_seqn, 0, EVENT_PRIORITY_NORMAL);
+  round = round_find(last_event_seqn, 0);
+  CHECK(round != NULL);
+  if (round == NULL) return;
+
+  if (early) {
+    /* Last reading completes the round */
+    for (i = 0; i < num_sensors; ++i)
+      collect_cb(last_event_seqn, 0, i, value[i], threshold[i]);
+    return;
+  }
+
+  for (i = 0; i < num_sensors; ++i) {
+    round->sensor_readings[i].value = value[i];
+    round->sensor_readings[i].threshold = threshold[i];
+    round->sensor_readings[i].reading_available = true;
+  }
+  round->num_sensor_readings = num_sensors;
+  collect_timer_cb(round);
+}
+
+/* --- BENCHMARK --- */
+static void benchmark(void) {
+  struct round_t *round = &rounds[0];
+  struct sensor_reading_t readings[MAX_SENSORS];
+  struct sensor_reading_t baseline[MAX_SENSORS];
+  clock_t start;
+  clock_t closed_form_time;
+  clock_t baseline_time;
+  unsigned k;
+  size_t i;
+
+  /* Full round, every threshold raised by several multiples of the min */
+  num_sensors = MAX_SENSORS;
+  for (i = 0; i < num_sensors; ++i) {
+    readings[i].value = 1000 + i * (CONTROLLER_MAX_DIFF / 2 / MAX_SENSORS);
+    readings[i].threshold = 100;
+    readings[i].command = COMMAND_TYPE_NONE;
+    readings[i].reading_available = true;
+    readings[i].reading_cached = false;
+    readings[i].command_sent = false;
+    readings[i].pulled = false;
+  }
+  round->num_sensor_readings = num_sensors;
+
+  start = clock();
+  for (k = 0; k < NUM_REPETITIONS; ++k) {
+    memcpy(round->sensor_readings, readings, sizeof(readings));
+    actuation_logic(round);
+  }
+  closed_form_time = clock() - start;
+
+  start = clock();
+  for (k = 0; k < NUM_REPETITIONS; ++k) {
+    memcpy(baseline, readings, sizeof(readings));
+    CHECK(baseline_logic(baseline));
+  }
+  baseline_time = clock() - start;
+
+  printf("%u sensors: closed form %.1f us, baseline %.1f us per round\n",
+         MAX_SENSORS,
+         closed_form_time * 1e6 / CLOCKS_PER_SEC / NUM_REPETITIONS,
+         baseline_time * 1e6 / CLOCKS_PER_SEC / NUM_REPETITIONS);
+}
+
+/* --- BASELINE --- */
+static bool baseline_logic(struct sensor_reading_t *sensor_readings) {
+  size_t iterations;
+  size_t i;
+  size_t j;
+  bool restart_check;
+  uint32_t value_min;
+
+  for (iterations = 0; iterations < BASELINE_MAX_ITERATIONS; ++iterations) {
+    restart_check = false;
+    value_min = UINT32_MAX;
+
+    /* Find min */
+    for (i = 0; i < num_sensors; ++i) {
+      if (sensor_readings[i].reading_available)
+        value_min = MIN(value_min, sensor_readings[i].value);
+    }
+
+    /* Check for any violation of the steady state condition, and for sensors
+     * with outdated thresholds */
+    for (i = 0; i < num_sensors; ++i) {
+      for (j = 0; j < num_sensors; ++j) {
+        if (!sensor_readings[i].reading_available) continue;
+
+        if (sensor_readings[j].reading_available &&
+            (sensor_readings[i].value >=
+                 sensor_readings[j].value + CONTROLLER_MAX_DIFF ||
+             sensor_readings[i].threshold > CONTROLLER_MAX_THRESHOLD)) {
+          /* Case 1: RESET */
+          sensor_readings[i].command = COMMAND_TYPE_RESET;
+          sensor_readings[i].value = 0;
+          sensor_readings[i].threshold = CONTROLLER_MAX_DIFF;
+          restart_check = true;
+        } else if (sensor_readings[i].value > sensor_readings[i].threshold) {
+          /* Case 2: THRESHOLD */
+          sensor_readings[i].command = COMMAND_TYPE_THRESHOLD;
+          sensor_readings[i].threshold += value_min;
+          restart_check = true;
+        }
+      }
+    }
+
+    /* Stop if no value changed */
+    if (!restart_check) return true;
+  }
+
+  return false;
+}
+
+/* --- ROUNDS --- */
+static uint8_t random_round(struct sensor_reading_t *sensor_readings) {
+  struct sensor_reading_t *sensor_reading;
+  uint8_t num_readings = 0;
+  size_t i;
+
+  for (i = 0; i < num_sensors; ++i) {
+    sensor_reading = &sensor_readings[i];
+    sensor_reading->reading_available = rand() % 5 != 0;
+    sensor_reading->reading_cached = false;
+    sensor_reading->command_sent = false;
+    sensor_reading->pulled = false;
+    sensor_reading->command = COMMAND_TYPE_NONE;
+    /* Values around the maximum difference, a few 0 */
+    sensor_reading->value =
+        rand() % 50 == 0 ? 0 : rand() % (2 * CONTROLLER_MAX_DIFF);
+    /* Thresholds at the default, below the value or out of range */
+    sensor_reading->threshold =
+        rand() % 3 == 0 ? CONTROLLER_MAX_DIFF
+                        : rand() % (CONTROLLER_MAX_THRESHOLD + 5000);
+    if (sensor_reading->reading_available) num_readings += 1;
+  }
+
+  return num_readings;
+}
+
+/* --- STUBS --- */
+size_t registry_length(void) { return num_sensors; }
+
+const linkaddr_t *registry_get(uint8_t slot) {
+  (void)slot;
+  return &address;
+}
+
+clock_time_t clock_time(void) { return 0; }
+
+void ctimer_set(struct ctimer *c, clock_time_t t, void (*f)(void *),
+                void *ptr) {
+  (void)t;
+  c->f = f;
+  c->ptr = ptr;
+}
+
+void ctimer_stop(struct ctimer *c) { c->f = NULL; }
+
+void etc_open(uint16_t channel, const struct etc_callbacks_t *callbacks) {
+  (void)channel;
+  (void)callbacks;
+}
+
+bool etc_command(uint16_t event_seqn, uint8_t event_source, uint8_t receiver,
+                 enum command_type_t command, uint32_t threshold) {
+  (void)event_seqn;
+  (void)event_source;
+  sent[receiver].receiver = receiver;
+  sent[receiver].command = command;
+  sent[receiver].threshold = threshold;
+  return true;
+}
+
+bool etc_collect_request(uint16_t event_seqn, uint8_t event_source,
+                         const uint8_t *sensors) {
+  (void)event_seqn;
+  (void)event_source;
+  (void)sensors;
+  return true;
+}
+
+bool etc_round_end(uint16_t event_seqn, uint8_t event_source,
+                   const uint8_t *collected,
+                   const struct command_entry_t *commands,
+                   uint8_t num_commands) {
+  (void)event_seqn;
+  (void)event_source;
+  (void)collected;
+  for (; num_commands > 0; --num_commands, ++commands)
+    sent[commands->receiver] = *commands;
+  return true;
+}
+
+void logger_log(enum log_level_t level, const char *file, int line,
+                const char *fmt, ...) {
+  (void)level;
+  (void)file;
+  (void)line;
+  (void)fmt;
+}
@@ -0,0 +1,276 @@
+/*
+ * Host test vectors of the wire encoding (see src/connection/codec.h).
+ * Build and run with `make test`.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "connection/codec.h"
+
+/**
+ * @brief Encoding buffer size in byte (larger than any message).
+ */
+#define BUFFER_SIZE (128)
+
+/**
+ * @brief Check a condition, report the failure and count it.
+ */
+#define CHECK(cond)                                          \
+  do {                                                       \
+    if (!(cond)) {                                           \
+      printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      failures += 1;                                         \
+    }                                                        \
+  } while (0)
+
+/**
+ * @brief Number of failed checks.
+ */
+static unsigned failures;
+
+/**
+ * @brief Varint boundary values.
+ */
+static const uint32_t values[] = {
+    0,       1,       127,       128,       300,       16383,
+    16384,   2097151, 2097152,   268435455, 268435456, UINT32_MAX};
+
+/**
+ * @brief Number of varint boundary values.
+ */
+#define NUM_VALUES (sizeof(values) / sizeof(values[0]))
+
+/**
+ * @brief Collect message golden vector and round trip.
+ */
+static void test_collect(void);
+
+/**
+ * @brief Command message golden vector and round trip.
+ */
+static void test_command(void);
+
+/**
+ * @brief Round end message golden vector and round trip.
+ */
+static void test_round_end(void);
+
+/**
+ * @brief Malformed varints (overflowing or longer than
+ * CODEC_VARINT_MAX_SIZE) are rejected.
+ */
+static void test_varint_malformed(void);
+
+/* --- --- */
+int main(void) {
+  test_collect();
+  test_command();
+  test_round_end();
+  test_varint_malformed();
+
+  if (failures != 0) {
+    printf("%u check(s) failed\n", failures);
+    return 1;
+  }
+  printf("All codec checks passed\n");
+  return 0;
+}
+
+/* --- COLLECT --- */
+static void test_collect(void) {
+  struct collect_msg_t msg;
+  struct collect_msg_t out;
+  uint8_t buffer[BUFFER_SIZE];
+  uint8_t expected[BUFFER_SIZE];
+  size_t expected_length = 0;
+  size_t length;
+  size_t i;
+
+  /* Golden vector: one reading */
+  memset(&msg, 0, sizeof(msg));
+  msg.event_seqn = 0x1234;
+  msg.event_source = 3;
+  msg.unchanged[0] = 1 << 5;
+  msg.num_readings = 1;
+  msg.readings[0].sender = 2;
+  msg.readings[0].hops = 1;
+  msg.readings[0].value = 300;
+  msg.readings[0].threshold = 0;
+
+  expected[expected_length++] = CODEC_VERSION;
+  expected[expected_length++] = 0x34;
+  expected[expected_length++] = 0x12;
+  expected[expected_length++] = 3;
+  memcpy(&expected[expected_length], msg.unchanged, CONNECTION_SUBTREE_SIZE);
+  expected_length += CONNECTION_SUBTREE_SIZE;
+  expected[expected_length++] = 1;
+  expected[expected_length++] = 2;
+  expected[expected_length++] = 1;
+  expected[expected_length++] = 0xAC;
+  expected[expected_length++] = 0x02;
+  expected[expected_length++] = 0x00;
+
+  length = codec_collect_pack(buffer, sizeof(buffer), &msg);
+  CHECK(length == expected_length);
+  CHECK(memcmp(buffer, expected, expected_length) == 0);
+
+  /* Round trip: full message, boundary values */
+  msg.num_readings = ETC_COLLECT_AGGREGATION_MAX_SIZE;
+  for (i = 0; i < msg.num_readings; ++i) {
+    msg.readings[i].sender = i;
+    msg.readings[i].hops = i + 1;
+    msg.readings[i].value = values[i % NUM_VALUES];
+    msg.readings[i].threshold = values[NUM_VALUES - 1 - i % NUM_VALUES];
+  }
+  length = codec_collect_pack(buffer, sizeof(buffer), &msg);
+  CHECK(length != 0);
+  CHECK(codec_collect_unpack(&out, buffer, length));
+  CHECK(out.event_seqn == msg.event_seqn);
+  CHECK(out.event_source == msg.event_source);
+  CHECK(memcmp(out.unchanged, msg.unchanged, CONNECTION_SUBTREE_SIZE) == 0);
+  CHECK(out.num_readings == msg.num_readings);
+  for (i = 0; i < msg.num_readings; ++i) {
+    CHECK(out.readings[i].sender == msg.readings[i].sender);
+    CHECK(out.readings[i].hops == msg.readings[i].hops);
+    CHECK(out.readings[i].value == msg.readings[i].value);
+    CHECK(out.readings[i].threshold == msg.readings[i].threshold);
+  }
+
+  /* Truncated, trailing bytes, small buffer, version, too many readings */
+  for (i = 0; i < length; ++i) CHECK(!codec_collect_unpack(&out, buffer, i));
+  buffer[length] = 0;
+  CHECK(!codec_collect_unpack(&out, buffer, length + 1));
+  CHECK(codec_collect_pack(buffer, length - 1, &msg) == 0);
+  length = codec_collect_pack(buffer, sizeof(buffer), &msg);
+  buffer[0] = CODEC_VERSION + 1;
+  CHECK(!codec_collect_unpack(&out, buffer, length));
+  buffer[0] = CODEC_VERSION;
+  buffer[4 + CONNECTION_SUBTREE_SIZE] = ETC_COLLECT_AGGREGATION_MAX_SIZE + 1;
+  CHECK(!codec_collect_unpack(&out, buffer, length));
+}
+
+/* --- COMMAND --- */
+static void test_command(void) {
+  struct command_msg_t msg;
+  struct command_msg_t out;
+  uint8_t buffer[BUFFER_SIZE];
+  const uint8_t expected[] = {CODEC_VERSION, 0x01, 0x00, 4, 7,
+                              COMMAND_TYPE_THRESHOLD, 0x80, 0x01};
+  size_t length;
+  size_t i;
+
+  /* Golden vector */
+  msg.event_seqn = 1;
+  msg.event_source = 4;
+  msg.receiver = 7;
+  msg.command = COMMAND_TYPE_THRESHOLD;
+  msg.threshold = 128;
+
+  length = codec_command_pack(buffer, sizeof(buffer), &msg);
+  CHECK(length == sizeof(expected));
+  CHECK(memcmp(buffer, expected, sizeof(expected)) == 0);
+
+  /* Round trip: boundary values */
+  for (i = 0; i < NUM_VALUES; ++i) {
+    msg.threshold = values[i];
+    length = codec_command_pack(buffer, sizeof(buffer), &msg);
+    CHECK(length != 0);
+    CHECK(codec_command_unpack(&out, buffer, length));
+    CHECK(out.event_seqn == msg.event_seqn);
+    CHECK(out.event_source == msg.event_source);
+    CHECK(out.receiver == msg.receiver);
+    CHECK(out.command == msg.command);
+    CHECK(out.threshold == msg.threshold);
+  }
+
+  /* Truncated, trailing bytes, small buffer */
+  for (i = 0; i < length; ++i) CHECK(!codec_command_unpack(&out, buffer, i));
+  buffer[length] = 0;
+  CHECK(!codec_command_unpack(&out, buffer, length + 1));
+  CHECK(codec_command_pack(buffer, length - 1, &msg) == 0);
+}
+
+/* --- ROUND END --- */
+static void test_round_end(void) {
+  struct round_end_msg_t msg;
+  struct round_end_msg_t out;
+  uint8_t buffer[BUFFER_SIZE];
+  uint8_t expected[BUFFER_SIZE];
+  size_t expected_length = 0;
+  size_t length;
+  size_t i;
+
+  /* Golden vector: no commands */
+  memset(&msg, 0, sizeof(msg));
+  msg.event_seqn = 0xFFFF;
+  msg.event_source = 0;
+  msg.collected[0] = 0x0B;
+
+  expected[expected_length++] = CODEC_VERSION;
+  expected[expected_length++] = 0xFF;
+  expected[expected_length++] = 0xFF;
+  expected[expected_length++] = 0;
+  memcpy(&expected[expected_length], msg.collected, CONNECTION_SUBTREE_SIZE);
+  expected_length += CONNECTION_SUBTREE_SIZE;
+  expected[expected_length++] = 0;
+
+  length = codec_round_end_pack(buffer, sizeof(buffer), &msg);
+  CHECK(length == expected_length);
+  CHECK(memcmp(buffer, expected, expected_length) == 0);
+  CHECK(codec_round_end_unpack(&out, buffer, length));
+  CHECK(out.num_commands == 0);
+
+  /* Round trip: full bundle, boundary values */
+  msg.num_commands = ETC_COMMAND_BUNDLE_MAX_SIZE;
+  for (i = 0; i < msg.num_commands; ++i) {
+    msg.commands[i].receiver = i;
+    msg.commands[i].command = i % 2 ? COMMAND_TYPE_RESET : COMMAND_TYPE_PULL;
+    msg.commands[i].threshold = values[NUM_VALUES - 1 - i % NUM_VALUES];
+  }
+  length = codec_round_end_pack(buffer, sizeof(buffer), &msg);
+  CHECK(length != 0);
+  CHECK(codec_round_end_unpack(&out, buffer, length));
+  CHECK(out.event_seqn == msg.event_seqn);
+  CHECK(out.event_source == msg.event_source);
+  CHECK(memcmp(out.collected, msg.collected, CONNECTION_SUBTREE_SIZE) == 0);
+  CHECK(out.num_commands == msg.num_commands);
+  for (i = 0; i < msg.num_commands; ++i) {
+    CHECK(out.commands[i].receiver == msg.commands[i].receiver);
+    CHECK(out.commands[i].command == msg.commands[i].command);
+    CHECK(out.commands[i].threshold == msg.commands[i].threshold);
+  }
+
+  /* Truncated, trailing bytes, small buffer, too many commands */
+  for (i = 0; i < length; ++i)
+    CHECK(!codec_round_end_unpack(&out, buffer, i));
+  buffer[length] = 0;
+  CHECK(!codec_round_end_unpack(&out, buffer, length + 1));
+  CHECK(codec_round_end_pack(buffer, length - 1, &msg) == 0);
+  buffer[4 + CONNECTION_SUBTREE_SIZE] = ETC_COMMAND_BUNDLE_MAX_SIZE + 1;
+  CHECK(!codec_round_end_unpack(&out, buffer, length));
+}
+
+/* --- VARINT --- */
+static void test_varint_malformed(void) {
+  struct command_msg_t out;
+  /* Command header followed by the threshold varint */
+  uint8_t buffer[] = {CODEC_VERSION, 0x00, 0x00, 0, 0, COMMAND_TYPE_NONE,
+                      0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x00};
+  const size_t header = 6;
+
+  /* UINT32_MAX: largest valid 5 byte varint */
+  CHECK(codec_command_unpack(&out, buffer, header + 5));
+  CHECK(out.threshold == UINT32_MAX);
+
+  /* Overflowing 32 bit */
+  buffer[header + 4] = 0x10;
+  CHECK(!codec_command_unpack(&out, buffer, header + 5));
+
+  /* Longer than CODEC_VARINT_MAX_SIZE */
+  buffer[header + 4] = 0x80;
+  CHECK(!codec_command_unpack(&out, buffer, header + 6));
+
+  /* Continuation bit on the last byte */
+  buffer[header + 4] = 0x8F;
+  CHECK(!codec_command_unpack(&out, buffer, header + 5));
+}
@@ -0,0 +1,8 @@
+#ifndef _TEST_LIB_RANDOM_H_
+#define _TEST_LIB_RANDOM_H_
+
+/* Host stand-in of the Contiki header (only declarations are needed). */
+
+unsigned short random_rand(void);
+
+#endif
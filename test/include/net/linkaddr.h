@@ -0,0 +1,13 @@
+#ifndef _TEST_NET_LINKADDR_H_
+#define _TEST_NET_LINKADDR_H_
+
+/* Host stand-in of the Contiki header (only declarations are needed). */
+
+#include <stdint.h>
+
+typedef union {
+  unsigned char u8[2];
+  uint16_t u16;
+} linkaddr_t;
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef _TEST_SYS_CC_H_
+#define _TEST_SYS_CC_H_
+
+/* Host stand-in of the Contiki header (only declarations are needed). */
+
+#define MIN(n, m) (((n) < (m)) ? (n) : (m))
+#define MAX(n, m) (((n) < (m)) ? (m) : (n))
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef _TEST_SYS_CLOCK_H_
+#define _TEST_SYS_CLOCK_H_
+
+/* Host stand-in of the Contiki header (only declarations are needed). */
+
+typedef unsigned short clock_time_t;
+
+#define CLOCK_SECOND (128UL)
+
+clock_time_t clock_time(void);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef _TEST_SYS_CTIMER_H_
+#define _TEST_SYS_CTIMER_H_
+
+/* Host stand-in of the Contiki header (only declarations are needed). */
+
+#include "sys/clock.h"
+
+struct ctimer {
+  void (*f)(void *);
+  void *ptr;
+};
+
+void ctimer_set(struct ctimer *c, clock_time_t t, void (*f)(void *),
+                void *ptr);
+
+void ctimer_stop(struct ctimer *c);
+
+#endif